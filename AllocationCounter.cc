@@ -0,0 +1,89 @@
+#include "AllocationCounter.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <new>
+
+std::atomic<unsigned long long> AllocationCounter::fAllocations[AllocationCounter::kNumberOfStages];
+std::atomic<unsigned long long> AllocationCounter::fBytes[AllocationCounter::kNumberOfStages];
+unsigned long long AllocationCounter::fSteadyStateAllocations[AllocationCounter::kNumberOfStages];
+long int AllocationCounter::fSteadyStateEvents = -1;
+long int AllocationCounter::fSteadyStateHits = 0;
+
+#ifdef COUNT_ALLOCATIONS
+thread_local EAllocationStage AllocationCounter::fStage = EAllocationStage::kOther;
+
+void* operator new(std::size_t size) {
+	AllocationCounter::Count(size);
+	void* pointer = std::malloc(size == 0 ? 1 : size);
+	if(pointer == nullptr) {
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+#endif
+
+void AllocationCounter::Count(size_t bytes) {
+#ifdef COUNT_ALLOCATIONS
+	int stage = static_cast<int>(fStage);
+	fAllocations[stage].fetch_add(1, std::memory_order_relaxed);
+	fBytes[stage].fetch_add(bytes, std::memory_order_relaxed);
+#else
+	(void) bytes;
+#endif
+}
+
+void AllocationCounter::StartSteadyState(long int events, long int hits) {
+	for(int stage = 0; stage < kNumberOfStages; ++stage) {
+		fSteadyStateAllocations[stage] = fAllocations[stage].load(std::memory_order_relaxed);
+	}
+	fSteadyStateEvents = events;
+	fSteadyStateHits = hits;
+}
+
+void AllocationCounter::Print(long int events, long int hits) {
+	if(!Enabled()) {
+		return;
+	}
+	const char* names[kNumberOfStages] = {"other", "read", "process", "fill"};
+	long int steadyEvents = fSteadyStateEvents >= 0 ? events - fSteadyStateEvents : 0;
+	long int steadyHits = fSteadyStateEvents >= 0 ? hits - fSteadyStateHits : 0;
+	if(fSteadyStateEvents >= 0) {
+		std::cout<<"heap allocations (total, MB, per event, per event and per hit after the first "<<fSteadyStateEvents<<" events):"<<std::endl;
+	} else {
+		std::cout<<"heap allocations (total, MB, per event, no steady state reached):"<<std::endl;
+	}
+	for(int stage = 0; stage < kNumberOfStages; ++stage) {
+		unsigned long long allocations = fAllocations[stage].load(std::memory_order_relaxed);
+		unsigned long long steady = fSteadyStateEvents >= 0 ? allocations - fSteadyStateAllocations[stage] : 0;
+		std::cout<<"  "<<std::setw(8)<<std::left<<names[stage]<<std::right<<std::setw(12)<<allocations
+		         <<std::setw(12)<<fBytes[stage].load(std::memory_order_relaxed)/1024./1024.
+		         <<std::setw(12)<<(events > 0 ? static_cast<double>(allocations)/events : 0.);
+		if(fSteadyStateEvents >= 0) {
+			std::cout<<std::setw(12)<<(steadyEvents > 0 ? static_cast<double>(steady)/steadyEvents : 0.)
+			         <<std::setw(12)<<(steadyHits > 0 ? static_cast<double>(steady)/steadyHits : 0.);
+		}
+		std::cout<<std::endl;
+	}
+}
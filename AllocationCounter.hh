@@ -0,0 +1,41 @@
+#ifndef __ALLOCATIONCOUNTER_HH
+#define __ALLOCATIONCOUNTER_HH
+
+#include <atomic>
+#include <cstddef>
+
+// stages of the conversion that heap allocations are attributed to
+enum class EAllocationStage { kOther, kRead, kProcess, kFill, kNumberOfStages };
+
+// counts heap allocations per stage, only if compiled with COUNT_ALLOCATIONS (make COUNT_ALLOCATIONS=1),
+// which replaces the global operator new, otherwise this does nothing
+// creating an AllocationCounter attributes all allocations of this thread to its stage until it goes out of scope
+class AllocationCounter {
+public:
+#ifdef COUNT_ALLOCATIONS
+	AllocationCounter(EAllocationStage stage) : fPrevious(fStage) { fStage = stage; }
+	~AllocationCounter() { fStage = fPrevious; }
+	static bool Enabled() { return true; }
+#else
+	AllocationCounter(EAllocationStage) {}
+	static bool Enabled() { return false; }
+#endif
+
+	static void Count(size_t bytes);
+	// allocations after this are counted as steady state (i.e. after all channels, baskets, and buffers have been created)
+	static void StartSteadyState(long int events, long int hits);
+	static void Print(long int events, long int hits);
+
+private:
+#ifdef COUNT_ALLOCATIONS
+	EAllocationStage fPrevious;
+	static thread_local EAllocationStage fStage;
+#endif
+	static const int kNumberOfStages = static_cast<int>(EAllocationStage::kNumberOfStages);
+	static std::atomic<unsigned long long> fAllocations[kNumberOfStages];
+	static std::atomic<unsigned long long> fBytes[kNumberOfStages];
+	static unsigned long long fSteadyStateAllocations[kNumberOfStages];
+	static long int fSteadyStateEvents;
+	static long int fSteadyStateHits;
+};
+#endif
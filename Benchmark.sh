@@ -0,0 +1,97 @@
+#!/bin/bash
+# end-to-end benchmark of NTuple2EventTree with synthetic ntuples created by GenerateNTuple
+# prints one CSV line per measurement: number of hits and events, number of input files (shards), unzip threads,
+# wall time, hits/s, MB/s read and written, and peak resident memory
+
+usage() {
+	echo "usage: $0 [-s settings file] [-w work directory] [-n \"hit counts\"] [-t \"unzip threads\"] [-f \"input files\"] [-p hits/event] [-i interleave] [-o csv file]"
+	echo "defaults: -w benchmark -n \"10000 100000 1000000 10000000 100000000\" -t \"0\" -f \"1\" -p 10 -i 1, CSV is written to stdout"
+	exit 1
+}
+
+SETTINGS=""
+WORKDIR="benchmark"
+HITS="10000 100000 1000000 10000000 100000000"
+THREADS="0"
+FILES="1"
+HITSPEREVENT=10
+INTERLEAVE=1
+CSV=""
+
+while getopts "s:w:n:t:f:p:i:o:h" opt; do
+	case $opt in
+		s) SETTINGS=$(realpath "$OPTARG") ;;
+		w) WORKDIR="$OPTARG" ;;
+		n) HITS="$OPTARG" ;;
+		t) THREADS="$OPTARG" ;;
+		f) FILES="$OPTARG" ;;
+		p) HITSPEREVENT="$OPTARG" ;;
+		i) INTERLEAVE="$OPTARG" ;;
+		o) CSV=$(realpath "$OPTARG") ;;
+		*) usage ;;
+	esac
+done
+
+BINDIR=$(cd "$(dirname "$0")" && pwd)
+if [ ! -x "$BINDIR/NTuple2EventTree" ] || [ ! -x "$BINDIR/GenerateNTuple" ]; then
+	echo "NTuple2EventTree and GenerateNTuple have to be built first (make all)" >&2
+	exit 1
+fi
+TIME=$(command -v /usr/bin/time)
+if [ -z "$TIME" ]; then
+	echo "/usr/bin/time is needed to measure the peak memory" >&2
+	exit 1
+fi
+
+mkdir -p "$WORKDIR" || exit 1
+cd "$WORKDIR" || exit 1
+
+output() {
+	if [ -n "$CSV" ]; then
+		echo "$1" >> "$CSV"
+	else
+		echo "$1"
+	fi
+}
+
+output "hits,events,files,unzip_threads,seconds,hits_per_second,input_MB_per_second,output_MB_per_second,peak_rss_MB"
+
+RUN=0
+for hits in $HITS; do
+	events=$((hits/HITSPEREVENT))
+	for files in $FILES; do
+		# the synthetic input is only created once, the event numbers continue from one file to the next
+		INPUT=()
+		for ((file = 0; file < files; ++file)); do
+			name="synthetic_${hits}_${HITSPEREVENT}_${INTERLEAVE}_${file}of${files}.root"
+			if [ ! -f "$name" ]; then
+				"$BINDIR/GenerateNTuple" -of "$name" -ne $((events/files)) -fe $((file*(events/files))) -hpe "$HITSPEREVENT" -il "$INTERLEAVE" -seed $((file+1)) > /dev/null || exit 1
+			fi
+			INPUT+=("$name")
+		done
+		inputBytes=$(stat -c %s "${INPUT[@]}" | awk '{s += $1} END {print s+0}')
+
+		for threads in $THREADS; do
+			settings="settings_${threads}.dat"
+			if [ -n "$SETTINGS" ]; then
+				cat "$SETTINGS" > "$settings"
+			else
+				: > "$settings"
+			fi
+			echo "UnzipThreads: $threads" >> "$settings"
+			if [ "$INTERLEAVE" -gt 1 ]; then
+				echo "EventOrder: Unsorted" >> "$settings"
+			fi
+
+			rm -f analysis$(printf "%05d" $RUN)_*.root
+			"$TIME" -f "%e %M" -o time.txt "$BINDIR/NTuple2EventTree" -sf "$settings" -if "${INPUT[@]}" -rn $RUN > log_$RUN.txt 2>&1 || { echo "conversion failed, see $WORKDIR/log_$RUN.txt" >&2; exit 1; }
+			read seconds rss < <(tail -n 1 time.txt)
+			outputBytes=$(stat -c %s analysis$(printf "%05d" $RUN)_*.root | awk '{s += $1} END {print s+0}')
+			rm -f analysis$(printf "%05d" $RUN)_*.root
+
+			output "$(awk -v h=$hits -v e=$events -v f=$files -v t=$threads -v s=$seconds -v i=$inputBytes -v o=$outputBytes -v r=$rss \
+				'BEGIN { if(s <= 0) s = 0.01; printf "%d,%d,%d,%d,%.2f,%.0f,%.2f,%.2f,%.1f\n", h, e, f, t, s, h/s, i/s/1048576, o/s/1048576, r/1024 }')"
+			RUN=$((RUN+1))
+		done
+	done
+done
@@ -0,0 +1,685 @@
+#include "Configuration.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#include "TMath.h"
+#include "TNamed.h"
+
+#include "TGRSIMnemonic.h"
+
+#include "Utilities.hh"
+
+#include "AllocationCounter.hh"
+
+Configuration::Configuration(Settings* settings, const int& runNumber, const int& subRunNumber, TRunInfo* runInfo, bool writeFragmentTree, const ULong64_t& seed, bool writeBinaryFragments, const std::string& outputDirectory, bool inMemory)
+	: fSettings(settings), fOutputDirectory(outputDirectory), fInMemory(inMemory), fOutputBytes(0), fWriteFragmentTree(writeFragmentTree), fFragmentTreeEntries(0), fWriteBinaryFragments(writeBinaryFragments), fBinaryWriter(nullptr), fRunNumber(runNumber), fSubRunNumber(subRunNumber), fCurrentSubRunNumber(subRunNumber), fEventsInFile(0), fRunInfo(runInfo), fKValue(settings->KValue()), fEventNumber(0), fAcceptedEvents(0), fEmptyEvents(0), fRejectedEvents(0), fBelowThreshold(0), fOutsideTimeWindow(0)
+{
+	fRandom.SetSeed(seed);
+	if(!fOutputDirectory.empty() && fOutputDirectory.back() != '/') {
+		fOutputDirectory.push_back('/');
+	}
+
+	//create objects for the branches of the output trees, inactive systems don't get a branch
+	// GRIFFIN
+	fGriffin = fSettings->SystemActive(EDetectorSystem::kGriffin) ? new TGriffin : nullptr;
+
+	// BGO
+	fGriffinBgo = fSettings->SystemActive(EDetectorSystem::kGriffinBgo) ? new TGriffinBgo : nullptr;
+
+	// LaBr
+	fLaBr = fSettings->SystemActive(EDetectorSystem::kLaBr) ? new TLaBr : nullptr;
+
+	// SCEPTAR
+	fSceptar = fSettings->SystemActive(EDetectorSystem::kSceptar) ? new TSceptar : nullptr;
+
+	// DESCANT
+	fDescant = fSettings->SystemActive(EDetectorSystem::kDescant) ? new TDescant : nullptr;
+
+	// PACES
+	fPaces = fSettings->SystemActive(EDetectorSystem::kPaces) ? new TPaces : nullptr;
+
+	// Fragments
+	// the fragments of one event are collected in this vector, which keeps its capacity from event to event
+	fFragments.reserve(64);
+	fSharedFragment = std::make_shared<TFragment>();
+	fFragment = fSharedFragment.get();
+	if(fSettings->VerbosityLevel() > 0) {
+		std::cout<<"created new fragment "<<fFragment<<std::endl;
+	}
+
+	OpenOutput();
+}
+
+Configuration::~Configuration() {
+	CloseOutput();
+	//the trees are deleted with their files, so the branch objects can be deleted now
+	delete fGriffin;
+	delete fGriffinBgo;
+	delete fLaBr;
+	delete fSceptar;
+	delete fDescant;
+	delete fPaces;
+}
+
+void Configuration::OpenOutput() {
+	if(!OutputAvailable()) {
+		throw;
+	}
+
+	//create output file
+	if(fInMemory) {
+		fAnalysisFile = new TMemFile(Form("%sanalysis%05d_%03d.root", fOutputDirectory.c_str(), fRunNumber, fCurrentSubRunNumber), "recreate");
+	} else {
+		fAnalysisFile = new TFile(Form("%sanalysis%05d_%03d.root", fOutputDirectory.c_str(), fRunNumber, fCurrentSubRunNumber), "recreate");
+	}
+	if(!fAnalysisFile->IsOpen()) {
+		std::cerr<<"Failed to open file '"<<Form("%sanalysis%05d_%03d.root", fOutputDirectory.c_str(), fRunNumber, fCurrentSubRunNumber)<<"', check permissions on directory and disk space!"<<std::endl;
+		throw;
+	}
+	if(fSettings->VerbosityLevel() > 0) {
+		std::cout<<"writing to "<<fAnalysisFile->GetName()<<std::endl;
+	}
+
+	//create tree, it belongs to the output file (and is deleted when the file is closed)
+	fEventTree = new TTree("AnalysisTree", "AnalysisTree");
+	fEventTree->SetDirectory(fAnalysisFile);
+	if(fWriteFragmentTree) {
+		if(fInMemory) {
+			fFragmentFile = new TMemFile(Form("%sfragment%05d_%03d.root", fOutputDirectory.c_str(), fRunNumber, fCurrentSubRunNumber), "recreate");
+		} else {
+			fFragmentFile = new TFile(Form("%sfragment%05d_%03d.root", fOutputDirectory.c_str(), fRunNumber, fCurrentSubRunNumber), "recreate");
+		}
+		if(!fFragmentFile->IsOpen()) {
+			std::cerr<<"Failed to open file '"<<Form("%sfragment%05d_%03d.root", fOutputDirectory.c_str(), fRunNumber, fCurrentSubRunNumber)<<"', check permissions on directory and disk space!"<<std::endl;
+			throw;
+		}
+		fFragmentTree = new TTree("FragmentTree", "FragmentTree");
+		fFragmentTree->SetDirectory(fFragmentFile);
+	}
+	if(fWriteBinaryFragments) {
+		fBinaryWriter = new MidasFragmentWriter(Form("%sfragment%05d_%03d.mid", fOutputDirectory.c_str(), fRunNumber, fCurrentSubRunNumber), fRunNumber, static_cast<size_t>(fSettings->BinaryBufferSizeMB())*1024*1024, fSettings->BinaryDirectIO());
+		if(!fBinaryWriter->IsOpen()) {
+			std::cerr<<"Failed to open file '"<<Form("%sfragment%05d_%03d.mid", fOutputDirectory.c_str(), fRunNumber, fCurrentSubRunNumber)<<"', check permissions on directory and disk space!"<<std::endl;
+			throw;
+		}
+	}
+
+	//create branches for output tree
+	if(fGriffin != nullptr)    fEventTree->Branch("TGriffin", &fGriffin, fSettings->BufferSize());
+	if(fGriffinBgo != nullptr) fEventTree->Branch("TGriffinBgo", &fGriffinBgo, fSettings->BufferSize());
+	if(fLaBr != nullptr)       fEventTree->Branch("TLaBr", &fLaBr, fSettings->BufferSize());
+	if(fSceptar != nullptr)    fEventTree->Branch("TSceptar", &fSceptar, fSettings->BufferSize());
+	if(fDescant != nullptr)    fEventTree->Branch("TDescant", &fDescant, fSettings->BufferSize());
+	if(fPaces != nullptr)      fEventTree->Branch("TPaces", &fPaces, fSettings->BufferSize());
+
+	// with a trigger not all events are written, so we keep track of the original event number
+	if(fSettings->TriggerEnabled()) {
+		fEventTree->Branch("eventNumber", &fEventNumber, "eventNumber/I");
+	}
+
+	if(fWriteFragmentTree) {
+		fFragmentTree->Branch("Fragment", &fFragment, fSettings->BufferSize());
+	}
+
+	fEventsInFile = 0;
+}
+
+bool Configuration::OutputAvailable() {
+	//rollover files take the numbers of the following sub-runs, which might be converted on their own before or after this one
+	//so each rollover file is marked with the sub-run it belongs to, and an existing file is only overwritten if it belongs to the same sub-run
+	if(fInMemory) {
+		return true;
+	}
+	std::string owner;
+	if(fCurrentSubRunNumber != fSubRunNumber) {
+		owner = Form("%05d_%03d", fRunNumber, fSubRunNumber);
+	}
+	std::string fileName = Form("%sanalysis%05d_%03d.root", fOutputDirectory.c_str(), fRunNumber, fCurrentSubRunNumber);
+	if(FileExists(fileName)) {
+		std::string existingOwner;
+		TFile* file = TFile::Open(fileName.c_str(), "read");
+		if(file != nullptr) {
+			if(file->IsOpen()) {
+				TNamed* marker = file->Get<TNamed>("RolloverOf");
+				if(marker != nullptr) {
+					existingOwner = marker->GetTitle();
+				}
+				file->Close();
+			}
+			delete file;
+		}
+		if(existingOwner != owner) {
+			std::cerr<<"Output file '"<<fileName<<"' already exists and belongs to "<<(existingOwner.empty() ? "its own sub-run" : "the rollover of sub-run " + existingOwner)<<", not overwriting it!"<<std::endl;
+			return false;
+		}
+	} else if(!owner.empty()) {
+		//fragment files without an analysis file can only come from a conversion of that sub-run
+		std::string fragmentName = Form("%sfragment%05d_%03d", fOutputDirectory.c_str(), fRunNumber, fCurrentSubRunNumber);
+		if((fWriteFragmentTree && FileExists(fragmentName + ".root")) || (fWriteBinaryFragments && FileExists(fragmentName + ".mid"))) {
+			std::cerr<<"Fragment file '"<<fragmentName<<"' of sub-run "<<fCurrentSubRunNumber<<" already exists, not overwriting it with the rollover of sub-run "<<owner<<"!"<<std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+void Configuration::CloseOutput() {
+	//each file gets the run info with its own sub-run number, so the rollover files can be told apart and ordered
+	fRunInfo->SetRunNumber(fRunNumber);
+	fRunInfo->SetSubRunNumber(fCurrentSubRunNumber);
+	if(fAnalysisFile->IsOpen()) {
+		fAnalysisFile->cd();
+		fEventTree->Write("AnalysisTree");
+		fOutputBytes += fEventTree->GetZipBytes();
+		if(fCurrentSubRunNumber != fSubRunNumber) {
+			TNamed marker("RolloverOf", Form("%05d_%03d", fRunNumber, fSubRunNumber));
+			marker.Write("RolloverOf");
+		}
+		fRunInfo->Write("RunInfo");
+		TChannel::WriteToRoot();
+		fAnalysisFile->Close();
+	}
+	delete fAnalysisFile;
+	fAnalysisFile = nullptr;
+	fEventTree = nullptr;
+	if(fWriteFragmentTree) {
+		if(fFragmentFile->IsOpen()) {
+			fFragmentFile->cd();
+			fFragmentTree->Write("FragmentTree");
+			fOutputBytes += fFragmentTree->GetZipBytes();
+			fRunInfo->Write("RunInfo");
+			TChannel::WriteToRoot();
+			fFragmentFile->Close();
+		}
+		delete fFragmentFile;
+		fFragmentFile = nullptr;
+		fFragmentTree = nullptr;
+	}
+	if(fWriteBinaryFragments) {
+		if(!fBinaryWriter->Close()) {
+			std::cerr<<"Failed to write binary fragments, check disk space!"<<std::endl;
+		}
+		delete fBinaryWriter;
+		fBinaryWriter = nullptr;
+	}
+}
+
+Long64_t Configuration::OutputBytes() {
+	Long64_t bytes = fOutputBytes;
+	fEventTree->FlushBaskets();
+	bytes += fEventTree->GetZipBytes();
+	if(fWriteFragmentTree) {
+		fFragmentTree->FlushBaskets();
+		bytes += fFragmentTree->GetZipBytes();
+	}
+	return bytes;
+}
+
+int Configuration::Cfd(EDigitizer digitizer, const Hit& hit)
+{
+   switch(digitizer) {
+		case EDigitizer::kGRF16:
+			// cfd is in 10/16th of a nanosecond, and replaces the lowest 18 bit of timestamp
+			// so multiply the time by 16e8, and use only the lowest 22 bit
+			return static_cast<int>(hit.fTime*16e8)&0x3fffff;
+		case EDigitizer::kGRF4G:
+			{
+			// calculate cfd (0 - 8 ns) in 1/256 ns
+			int cfd = hit.fTime*256e9;
+			cfd = cfd%1024;//1024 = 256 steps for 0 - 8 ns
+			// calculate remainder between 8 ns timestamp and 10 ns timestamp
+			int rem = hit.fTime*1e9;
+			rem = rem%40;
+			if(rem < 8)       rem = 0;
+			else if(rem < 16) rem = 8;
+			else if(rem < 24) rem = 6;
+			else if(rem < 32) rem = 4;
+			else              rem = 2;
+			return (rem << 22) | cfd;
+			}
+		case EDigitizer::kTIG10:
+			// cfd is in 10/16th of a nanosecond, and replaces the lowest 23 bit of timestamp
+			return static_cast<int>(hit.fTime*16e8)&0x7ffffff;
+		default:
+			return 0;
+	}
+}
+
+void Configuration::AddHit(Hit hit) {
+	//if this hit is from the next event, we fill the tree with everything we've collected so far and reset the vector(s)
+	if((hit.fEventNumber != fEventNumber) && ((fSettings->SortNumberOfEvents()==0)||(fSettings->SortNumberOfEvents()>=fEventNumber))) {
+		FlushEvent();
+		fEventNumber = hit.fEventNumber;
+	}
+
+	ProcessHit(hit);
+}
+
+void Configuration::AddEvent(const Hit* hits, size_t nHits) {
+	if(nHits > 0) {
+		fEventNumber = hits[0].fEventNumber;
+	}
+	for(size_t i = 0; i < nHits; ++i) {
+		ProcessHit(hits[i]);
+	}
+	FlushEvent();
+}
+
+void Configuration::ProcessHit(Hit hit) {
+	AllocationCounter stage(EAllocationStage::kProcess);
+	float smearedEnergy;
+	TChannel* channel;
+	uint32_t address;
+	const char* crystalColor = "BGRW";
+
+	//hits of inactive systems are dropped before any random numbers are drawn or channels are created
+	if(!fSettings->HitActive(hit.fSystemID)) {
+		return;
+	}
+
+	// if the system ID is NOT GRIFFIN, then set the crystal number to zero
+	// This is a quick fix to solve resolution and threshold values from Settings.cc
+	if(hit.fSystemID >= 2000) {
+		hit.fCryNumber = 0;
+	}
+	//create energy-resolution smeared energy
+	if(fSettings->DontSmearEnergy()) {
+		smearedEnergy = hit.fDepEnergy;
+	} else {
+		smearedEnergy = fRandom.Gaus(hit.fDepEnergy, fSettings->Resolution(hit.fSystemID,hit.fDetNumber,hit.fCryNumber,hit.fDepEnergy));
+	}
+
+	if((fSettings->SortNumberOfEvents()==0)||(fSettings->SortNumberOfEvents()>=hit.fEventNumber) ) {
+		//if the hit is above the threshold, we add it to the vector
+		if(AboveThreshold(smearedEnergy, hit)) {
+			if(InsideTimeWindow(hit) ) {
+				switch(hit.fSystemID) {
+					//mapping systems to address ranges: 0 - GRIFFIN, 1 - BGO, 2 - LaBr, 3 - ancilliary BGO, 4 - NaI, 5 - SCEPTAR, 6 - SPICE, 7 - PACES, 8 - DESCANT
+					case 1000://griffin
+						address = 4*hit.fDetNumber + hit.fCryNumber;
+						break;
+					case 1010://left extension suppressor
+					case 1020://right extension suppressor
+					case 1030://left casing suppressor
+					case 1040://right casing suppressor
+					case 1050://back suppressor
+						address = 1000 + 10*hit.fDetNumber + hit.fCryNumber;
+						break;
+					case 10://SPICE
+						address = 6000 + hit.fDetNumber;
+						break;
+					case 50://PACES
+						address = 7000 + hit.fDetNumber;
+						break;
+					case 6000://8pi
+					case 6010://8pi inner BGO
+					case 6020://8pi outer BGO
+						std::cerr<<"Sorry, 8pi is not implemented in GRSISort!"<<std::endl;
+						throw;
+					case 7000:
+						std::cerr<<"Sorry, gridcell is not implemented in GRSISort!"<<std::endl;
+						throw;
+					// DESCANT: detectors are numbered 1-x for each color
+					// until I figure out which one goes where, I'll just add them up
+					case 8010://blue
+						//hit.fDetNumber += 10; // 10 green detectors
+					case 8020://green
+						//hit.fDetNumber += 15; // 15 red detectors
+					case 8030://red
+						//hit.fDetNumber += 20; // 20 white detectors
+					case 8040://white
+						//hit.fDetNumber += 10; // 10 yellow detectors
+					case 8050://yellow
+						if(hit.fDetNumber < 16) {
+							address = 0x8400 + hit.fDetNumber;
+						} else if(hit.fDetNumber < 32) {
+							address = 0x8800 + hit.fDetNumber - 16;
+						} else if(hit.fDetNumber < 48) {
+							address = 0x8c00 + hit.fDetNumber - 32;
+						} else if(hit.fDetNumber < 59) {
+							address = 0x9000 + hit.fDetNumber - 48;
+						} else {
+							address = 0x9400 + hit.fDetNumber - 59;
+						}
+						break;
+					case 8500://testcan
+						std::cerr<<"Sorry, testcan is not implemented in GRSISort!"<<std::endl;
+						throw;
+					default: //2000 - LaBr, 3000 - ancillary BGO, 4000 - NaI, 5000 - Sceptar
+						address = hit.fSystemID + hit.fDetNumber;
+						break;
+				}
+				FragmentRecord* fragment = FindFragment(address);
+				if(fragment != nullptr) {
+					// add charge
+					fragment->fCharge += smearedEnergy*fKValue;
+					// update timestamp
+					fragment->fTimeStamp = hit.fTime*1e8;
+				} else {
+					fFragments.push_back(FragmentRecord());
+					fragment = &fFragments.back();
+					fragment->fAddress = address;
+					fragment->fCfd = 0;
+					fragment->fCharge = smearedEnergy*fKValue;
+					fragment->fKValue = fKValue;
+					// hit.fTime is the time from the beginning of the event in seconds
+					fragment->fDaqTimeStamp = hit.fTime;
+					fragment->fTimeStamp = hit.fTime*1e8;
+					// the CFD is set for every new fragment, independent of whether this configuration created the (process-wide) channel
+					if(hit.fSystemID != 10) {
+						fragment->fCfd = Cfd(EDigitizer::kGRF16, hit);
+					}
+					++fFragmentTreeEntries;
+					//check if the channel for this address exists, and if not create one and add it to the map
+					channel = TChannel::GetChannel(address);
+					if(channel == nullptr) {
+						//the mnemonic is only created once per channel, so this doesn't allocate for every hit
+						std::string mnemonic;
+						std::string digitizerType;
+                            // simulation outputs detector numbers [0,15] but we want [1,16] for
+                            // assigning mnemonics
+                            ++hit.fDetNumber;
+
+						switch(hit.fSystemID) {
+							case 1000://griffin
+								mnemonic = Form("GRG%02d%cN00A", hit.fDetNumber, crystalColor[hit.fCryNumber]);
+								digitizerType = "GRF16";
+								break;
+							case 1010://left extension suppressor
+							case 1020://right extension suppressor
+							case 1030://left casing suppressor
+							case 1040://right casing suppressor
+							case 1050://back suppressor
+								mnemonic = Form("GRS%02d%cN00A", hit.fDetNumber, crystalColor[hit.fCryNumber]);
+								digitizerType = "GRF16";
+								break;
+							case 2000://LABr
+								mnemonic = Form("DAL%02dXN00X", hit.fDetNumber);
+								digitizerType = "GRF16";
+								break;
+							case 3000://ancilliary BGO
+								mnemonic = Form("DAS%02dXN00X", hit.fDetNumber);
+								digitizerType = "GRF16";
+								break;
+							case 5000://SCEPTAR
+								mnemonic = Form("SEP%02dXN00X", hit.fDetNumber);
+								digitizerType = "GRF16";
+								break;
+							case 10://SPICE
+								mnemonic = Form("SPI%02dXN%0dX", hit.fDetNumber, hit.fCryNumber);//TODO: fix SPICE mnemonic
+								break;
+							case 50://PACES
+								mnemonic = Form("PAC%02dXN00A", hit.fDetNumber);
+								break;
+							case 8010://blue
+							case 8020://green
+							case 8030://red
+							case 8040://white
+							case 8050://yellow
+								mnemonic = Form("DSC%02dXN00X", hit.fDetNumber);
+								digitizerType = "CAEN";
+								break;
+							default: 
+								std::cerr<<"Sorry, unknown system ID "<<hit.fSystemID<<std::endl;
+								throw;
+						}
+						channel = new TChannel;
+						channel->SetAddress(address);
+						channel->SetName(mnemonic.c_str());
+						channel->SetDetectorNumber(hit.fDetNumber);
+						channel->SetCrystalNumber(hit.fCryNumber);
+						channel->SetDigitizerType(TPriorityValue<std::string>(digitizerType, EPriority::kRootFile));
+						TChannel::AddChannel(channel);
+					}
+					if(fSettings->VerbosityLevel() > 1) {
+						std::cout<<"Initialized values of fragment at address "<<address<<" = 0x"<<std::hex<<address<<std::dec<<std::endl;
+						fragment->Print();
+					}
+				}
+			} else {
+				++fOutsideTimeWindow;
+			}
+		} else {
+			++fBelowThreshold;
+		}
+	}
+}
+
+void Configuration::FlushEvent() {
+	AllocationCounter stage(EAllocationStage::kFill);
+	if(fSettings->VerbosityLevel() > 2) {
+		std::cout<<fEventNumber<<": "<<fFragments.size()<<" fragments, "<<fBelowThreshold<<" hits below treshold, "<<fOutsideTimeWindow<<" hits outside time window"<<std::endl;
+	}
+	// events that don't fulfill the trigger condition are dropped before anything is added to the detectors
+	if(!Triggered()) {
+		fBelowThreshold = 0;
+		fOutsideTimeWindow = 0;
+		fFragments.clear();
+		return;
+	}
+	++fAcceptedEvents;
+
+	// this takes the fragments we have collected and adds them to the detector classes
+	// it also automatically fills the fragment tree
+	FillDetectors();
+	// the fragments are sorted by address now, so the binary stream has the same order as the fragment tree
+	if(fWriteBinaryFragments) {
+		fBinaryWriter->WriteEvent(fFragments);
+	}
+
+	fEventTree->Fill(); // Tree contains suppressed data
+	++fEventsInFile;
+
+	if(fGriffin != nullptr)    fGriffin->Clear();
+	if(fGriffinBgo != nullptr) fGriffinBgo->Clear();
+	if(fLaBr != nullptr)       fLaBr->Clear();
+	if(fSceptar != nullptr)    fSceptar->Clear();
+	if(fDescant != nullptr)    fDescant->Clear();
+	if(fPaces != nullptr)      fPaces->Clear();
+
+	fBelowThreshold = 0;
+	fOutsideTimeWindow = 0;
+
+	fFragments.clear();
+
+	//once the current file is large enough, we continue with the next sub-run (so files always end on an event boundary)
+	if((fSettings->RolloverEvents() > 0 && fEventsInFile >= fSettings->RolloverEvents()) ||
+	   (fSettings->RolloverSizeMB() > 0. && fAnalysisFile->GetEND() >= fSettings->RolloverSizeMB()*1024.*1024.)) {
+		if(fSettings->VerbosityLevel() > 0) {
+			std::cout<<"closing "<<fAnalysisFile->GetName()<<" after "<<fEventsInFile<<" events"<<std::endl;
+		}
+		CloseOutput();
+		++fCurrentSubRunNumber;
+		OpenOutput();
+	}
+}
+
+void Configuration::FillDetectors() {
+	// the detector classes create their hits from the fragment, so the same fragment can be re-used for all of them
+	std::sort(fFragments.begin(), fFragments.end(), [](const FragmentRecord& a, const FragmentRecord& b) { return a.fAddress < b.fAddress; });
+	for(const auto& frag : fFragments) {
+		frag.CopyTo(fFragment);
+		if(fWriteFragmentTree) {
+			fFragmentTree->Fill();
+		}
+		TChannel* channel = TChannel::GetChannel(frag.fAddress);
+		switch(frag.fAddress/1000) {
+			//mapping systems to address ranges: 0 - GRIFFIN, 1 - BGO, 2 - LaBr, 3 - ancilliary BGO, 4 - NaI, 5 - SCEPTAR, 6 - SPICE, 7 - PACES, 8 - DESCANT
+			case 0:
+				fGriffin->AddFragment(fSharedFragment, channel);
+				if(fSettings->VerbosityLevel() > 2) {
+					std::cout<<"Added fragment "<<fFragment<<" to griffin:"<<std::endl;
+					fFragment->Print();
+				}
+				break;
+			case 1:
+			case 3:
+				fGriffinBgo->AddFragment(fSharedFragment, channel);
+				if(fSettings->VerbosityLevel() > 2) {
+					std::cout<<"Added fragment "<<fFragment<<" to bgo:"<<std::endl;
+					fFragment->Print();
+				}
+				break;
+			case 2:
+				fLaBr->AddFragment(fSharedFragment, channel);
+				if(fSettings->VerbosityLevel() > 2) {
+					std::cout<<"Added fragment "<<fFragment<<" to labr:"<<std::endl;
+					fFragment->Print();
+				}
+				break;
+			case 5:
+				fSceptar->AddFragment(fSharedFragment, channel);
+				if(fSettings->VerbosityLevel() > 2) {
+					std::cout<<"Added fragment "<<fFragment<<" to sceptar:"<<std::endl;
+					fFragment->Print();
+				}
+				break;
+			case 7:
+				fPaces->AddFragment(fSharedFragment, channel);
+				if(fSettings->VerbosityLevel() > 2) {
+					std::cout<<"Added fragment "<<fFragment<<" to paces:"<<std::endl;
+					fFragment->Print();
+				}
+				break;
+			case 33:
+			case 34:
+			case 35:
+			case 36:
+			case 37:
+				fDescant->AddFragment(fSharedFragment, channel);
+				if(fSettings->VerbosityLevel() > 2) {
+					std::cout<<"Added fragment "<<fFragment<<" to descant:"<<std::endl;
+					fFragment->Print();
+				}
+				break;
+
+			default:
+				if(fSettings->VerbosityLevel() > 1) {
+					std::cerr<<"Unknown address "<<frag.fAddress<<" = 0x"<<std::hex<<frag.fAddress<<std::dec<<std::endl;
+					frag.Print();
+				}
+				break;
+		}
+	}
+}
+
+FragmentRecord* Configuration::FindFragment(uint32_t address) {
+	// there are only a few fragments per event, so a linear search is faster than a map
+	for(auto& fragment : fFragments) {
+		if(fragment.fAddress == address) {
+			return &fragment;
+		}
+	}
+	return nullptr;
+}
+
+bool Configuration::AboveThreshold(double energy, const Hit& hit) {
+	if(hit.fSystemID == 5000) {
+		// apply hard threshold of 50 keV on Sceptar
+		// SCEPTAR in reality saturates at an efficiency of about 80%. In simulation we get an efficiency of 90%
+		// 0.9 * 1.11111111 = 100%, 0.8*1.1111111 = 0.888888888
+		if(energy > 50.0 && (fRandom.Uniform(0.,1.) < 0.88888888 )) {
+			return true;
+		} else {
+			return false;
+		}
+	} else if(energy > fSettings->Threshold(hit.fSystemID,hit.fDetNumber,hit.fCryNumber)+10*fSettings->ThresholdWidth(hit.fSystemID,hit.fDetNumber,hit.fCryNumber)) {
+		return true;
+	}
+
+	if(fRandom.Uniform(0.,1.) < 0.5*(TMath::Erf((energy-fSettings->Threshold(hit.fSystemID,hit.fDetNumber,hit.fCryNumber))/fSettings->ThresholdWidth(hit.fSystemID,hit.fDetNumber,hit.fCryNumber))+1)) {
+		return true;
+	}
+
+	return false;
+}
+
+bool Configuration::InsideTimeWindow(const Hit& hit) {
+	if(fSettings->TimeWindow(hit.fSystemID,hit.fDetNumber,hit.fCryNumber) == 0) {
+		return true;
+	}
+	if(hit.fTime < fSettings->TimeWindow(hit.fSystemID,hit.fDetNumber,hit.fCryNumber)) {
+		return true;
+	}
+	return false;
+}
+
+bool Configuration::DescantNeutronDiscrimination(const Hit& hit) { // Assuming perfect gamma-neutron discrimination
+	if(hit.fParticleType == 5) { // neutron
+		return true;
+	}
+	return false;
+}
+
+bool Configuration::Triggered() {
+	if(!fSettings->TriggerEnabled()) {
+		return true;
+	}
+	if(fFragments.empty()) {
+		++fEmptyEvents;
+		return false;
+	}
+
+	int multiplicity[static_cast<int>(EDetectorSystem::kNumberOfSystems)] = {0};
+	for(const auto& fragment : fFragments) {
+		int system = DetectorSystem(fragment.fAddress);
+		if(system >= 0) {
+			++multiplicity[system];
+		}
+	}
+
+	bool anyCondition = false;
+	bool anyFulfilled = false;
+	bool allFulfilled = true;
+	for(int system = 0; system < static_cast<int>(EDetectorSystem::kNumberOfSystems); ++system) {
+		int required = fSettings->TriggerMultiplicity(static_cast<EDetectorSystem>(system));
+		if(required <= 0) continue;
+		anyCondition = true;
+		if(multiplicity[system] >= required) {
+			anyFulfilled = true;
+		} else {
+			allFulfilled = false;
+		}
+	}
+
+	// only empty events are suppressed if there is no multiplicity condition
+	if(!anyCondition || (fSettings->TriggerRequireAll() ? allFulfilled : anyFulfilled)) {
+		return true;
+	}
+	++fRejectedEvents;
+	return false;
+}
+
+int Configuration::DetectorSystem(uint32_t address) {
+	//mapping systems to address ranges: 0 - GRIFFIN, 1 - BGO, 2 - LaBr, 3 - ancilliary BGO, 4 - NaI, 5 - SCEPTAR, 6 - SPICE, 7 - PACES, 8 - DESCANT
+	switch(address/1000) {
+		case 0:
+			return static_cast<int>(EDetectorSystem::kGriffin);
+		case 1:
+		case 3:
+			return static_cast<int>(EDetectorSystem::kGriffinBgo);
+		case 2:
+			return static_cast<int>(EDetectorSystem::kLaBr);
+		case 5:
+			return static_cast<int>(EDetectorSystem::kSceptar);
+		case 7:
+			return static_cast<int>(EDetectorSystem::kPaces);
+		case 33:
+		case 34:
+		case 35:
+		case 36:
+		case 37:
+			return static_cast<int>(EDetectorSystem::kDescant);
+		default:
+			return -1;
+	}
+}
+
+void Configuration::PrintStatistics() {
+	if(fSettings->TriggerEnabled()) {
+		std::cout<<"run "<<fRunNumber<<": accepted "<<fAcceptedEvents<<" events, rejected "<<fEmptyEvents<<" empty events and "<<fRejectedEvents<<" events not fulfilling the trigger condition"<<std::endl;
+	}
+}
+
@@ -0,0 +1,116 @@
+#ifndef __CONFIGURATION_HH
+#define __CONFIGURATION_HH
+
+#include <vector>
+#include <memory>
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TRandom3.h"
+#include "TMemFile.h"
+
+#include "TRunInfo.h"
+#include "TChannel.h"
+#include "TFragment.h"
+#include "TGriffin.h"
+#include "TGriffinBgo.h"
+#include "TSceptar.h"
+#include "TPaces.h"
+#include "TLaBr.h"
+#include "TDescant.h"
+
+#include "Settings.hh"
+#include "Hit.hh"
+#include "FragmentRecord.hh"
+#include "MidasFragmentWriter.hh"
+
+// one set of settings (resolutions, thresholds, time windows, ...) applied to the hits read by the converter
+// each configuration has its own random number generator and writes its own output file(s)
+class Configuration {
+public:
+	Configuration(Settings* settings, const int& runNumber, const int& subRunNumber, TRunInfo* runInfo, bool writeFragmentTree, const ULong64_t& seed, bool writeBinaryFragments = false, const std::string& outputDirectory = "", bool inMemory = false);
+	~Configuration();
+
+	// adds a hit from a stream of hits, the previous event is filled into the tree once the event number changes
+	void AddHit(Hit hit);
+	// processes all hits of one event and fills the event into the tree right away (for use without an ntuple)
+	void AddEvent(const Hit* hits, size_t nHits);
+	void AddEvent(const std::vector<Hit>& hits) { AddEvent(hits.data(), hits.size()); }
+
+	// fills the current event into the tree right away instead of waiting for the first hit of the next event
+	void Flush() { FlushEvent(); }
+
+	void PrintStatistics();
+	// compressed size of the output tree(s) written so far, flushes all baskets of the current tree(s)
+	Long64_t OutputBytes();
+
+private:
+	int  Cfd(EDigitizer, const Hit&);
+	bool AboveThreshold(double, const Hit&);
+	bool InsideTimeWindow(const Hit&);
+	bool DescantNeutronDiscrimination(const Hit&);
+	void OpenOutput();
+	// false if the output file of the current sub-run exists and belongs to a different sub-run
+	bool OutputAvailable();
+	void CloseOutput();
+	void ProcessHit(Hit hit);
+	void FlushEvent();
+	void FillDetectors();
+	bool Triggered();
+	static int DetectorSystem(uint32_t address);
+	FragmentRecord* FindFragment(uint32_t address);
+
+	Settings* fSettings;
+	// empty or ending in a slash
+	std::string fOutputDirectory;
+	// output is written to memory files (used to estimate size and speed of a conversion)
+	bool fInMemory;
+	Long64_t fOutputBytes;
+	TFile* fFragmentFile;
+	TFile* fAnalysisFile;
+	TTree* fEventTree;
+	std::shared_ptr<TFragment> fSharedFragment;
+	TFragment* fFragment;
+	std::vector<FragmentRecord> fFragments;
+	bool fWriteFragmentTree;
+	TTree* fFragmentTree;
+	int fFragmentTreeEntries;
+	bool fWriteBinaryFragments;
+	MidasFragmentWriter* fBinaryWriter;
+	int fRunNumber;
+	int fSubRunNumber;
+	int fCurrentSubRunNumber;
+	long int fEventsInFile;
+	// shared by all configurations, run and sub-run number are set before it is written to a file
+	TRunInfo* fRunInfo;
+	int fKValue;
+	TRandom3 fRandom;
+
+	int fEventNumber;
+	long int fAcceptedEvents;
+	long int fEmptyEvents;
+	long int fRejectedEvents;
+	// number of hits of the current event below threshold or outside the time window
+	int fBelowThreshold;
+	int fOutsideTimeWindow;
+
+	//branches of output tree
+	// GRIFFIN
+	TGriffin* fGriffin;
+
+	// BGO
+	TGriffinBgo* fGriffinBgo;
+
+	// LaBr
+	TLaBr* fLaBr;
+
+	// Sceptar
+	TSceptar* fSceptar;
+
+	// Descant
+	TDescant* fDescant;
+
+	// Paces
+	TPaces* fPaces;
+};
+#endif
@@ -2,170 +2,387 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cmath>
 
-#include "TMath.h"
+#include <sys/resource.h>
 
-#include "TGRSIMnemonic.h"
+#include "TROOT.h"
+#include "TBranch.h"
+#include "TTreeCacheUnzip.h"
+#include "TChainElement.h"
 
 #include "Utilities.hh"
 
-Converter::Converter(std::vector<std::string>& inputFileNames, const int& runNumber, const int& subRunNumber, const TRunInfo* runInfo, Settings* settings, bool writeFragmentTree)
-	: fSettings(settings), fWriteFragmentTree(writeFragmentTree), fFragmentTreeEntries(0), fRunNumber(runNumber), fSubRunNumber(subRunNumber), fRunInfo(runInfo), fKValue(settings->KValue())
+#include "AllocationCounter.hh"
+
+Converter::Converter(std::vector<std::string>& inputFileNames, Settings* settings, const std::string& cacheFileName)
+	: fSettings(settings), fEntryCounter(settings->EntryCountFile(), settings->NtupleName(), settings->VerbosityLevel()), fChainInitialized(false), fNumberOfEntries(-1), fChainError(false), fPrefetcher(nullptr), fTreeNumber(-1), fEventNumberBranch(nullptr), fEventNumberTree(-1), fSkippedHits(0), fInactiveHits(0), fInputTime(0), fMetrics(nullptr), fEvents(0), fHits(0), fLastEventNumber(0), fHit()
 {
-	//create TChain to read in all input files
+	//if there is a hit cache built from the same input files we read from it instead of the input files
+	//without input files the cache is used as it is
+	if(!cacheFileName.empty()) {
+		if(fCache.Open(cacheFileName)) {
+			if(inputFileNames.empty() || fCache.SameInput(inputFileNames)) {
+				std::cout<<"will read "<<fCache.NumberOfHits()<<" hits of "<<fCache.NumberOfEvents()<<" events from hit cache "<<cacheFileName<<" (ignoring input files)"<<std::endl;
+				return;
+			}
+			std::cout<<"hit cache "<<cacheFileName<<" was built from different input files (or they changed since), reading input files"<<std::endl;
+			fCache.Close();
+		} else {
+			std::cout<<"no valid hit cache "<<cacheFileName<<" found, reading input files"<<std::endl;
+		}
+	}
+
+	//the files are only added to the TChain once we start reading them (see InitChain)
 	for(auto fileName = inputFileNames.begin(); fileName != inputFileNames.end(); ++fileName) {
 		if(!FileExists(*fileName)) {
 			std::cerr<<"Failed to find file '"<<*fileName<<"', skipping it!"<<std::endl;
 			continue;
 		}
-		//add sub-directory and tree name to file name
-		fileName->append(fSettings->NtupleName());
-		fChain.Add(fileName->c_str(), -1);
-		fRandom.SetSeed(1);
+		fInputFiles.push_back(*fileName);
 	}
 
-	std::cout<<"will read from "<<fChain.GetListOfFiles()->GetEntries()<<" files"<<std::endl;
-	if(fChain.GetListOfFiles()->GetEntries() == 0) {
+	std::cout<<"will read from "<<fInputFiles.size()<<" files"<<std::endl;
+	if(fInputFiles.empty()) {
 		std::cout<<"no files found (maybe check tree name, settings say it's \""<<fSettings->NtupleName()<<"\"?)"<<std::endl;
 		throw;
 	}
 
+	//decompress baskets in parallel, read all branches through the cache, and read the next file ahead
+	if(fSettings->UnzipThreads() > 0) {
+		ROOT::EnableImplicitMT(fSettings->UnzipThreads());
+		TTreeCacheUnzip::SetParallelUnzip(TTreeCacheUnzip::kEnable);
+		fChain.SetImplicitMT(true);
+	}
+	if(fSettings->TreeCacheSizeMB() > 0) {
+		fChain.SetCacheSize(static_cast<Long64_t>(fSettings->TreeCacheSizeMB())*1024*1024);
+	}
+	if(fSettings->PrefetchSizeMB() > 0 && fInputFiles.size() > 1) {
+		fPrefetcher = new FilePrefetcher(static_cast<long long>(fSettings->PrefetchSizeMB())*1024*1024, fSettings->VerbosityLevel());
+	}
+
 	//add branches to input chain
-	fChain.SetBranchAddress("eventNumber", &fEventNumber);
-	fChain.SetBranchAddress("trackID", &fTrackID);
-	fChain.SetBranchAddress("parentID", &fParentID);
-	fChain.SetBranchAddress("stepNumber", &fStepNumber);
-	fChain.SetBranchAddress("particleType", &fParticleType);
-	fChain.SetBranchAddress("processType", &fProcessType);
-	fChain.SetBranchAddress("systemID", &fSystemID);
-	fChain.SetBranchAddress("detNumber", &fDetNumber);
-	fChain.SetBranchAddress("cryNumber", &fCryNumber);
-	fChain.SetBranchAddress("depEnergy", &fDepEnergy);
-	fChain.SetBranchAddress("posx", &fPosx);
-	fChain.SetBranchAddress("posy", &fPosy);
-	fChain.SetBranchAddress("posz", &fPosz);
-	fChain.SetBranchAddress("time", &fTime);
-
-	//create output file
-	fAnalysisFile = new TFile(Form("analysis%05d_%03d.root", fRunNumber, fSubRunNumber), "recreate");
-	if(!fAnalysisFile->IsOpen()) {
-		std::cerr<<"Failed to open file '"<<Form("analysis%05d_%03d.root", fRunNumber, fSubRunNumber)<<"', check permissions on directory and disk space!"<<std::endl;
-		throw;
+	fChain.SetBranchAddress("eventNumber", &fHit.fEventNumber);
+	fChain.SetBranchAddress("trackID", &fHit.fTrackID);
+	fChain.SetBranchAddress("parentID", &fHit.fParentID);
+	fChain.SetBranchAddress("stepNumber", &fHit.fStepNumber);
+	fChain.SetBranchAddress("particleType", &fHit.fParticleType);
+	fChain.SetBranchAddress("processType", &fHit.fProcessType);
+	fChain.SetBranchAddress("systemID", &fHit.fSystemID);
+	fChain.SetBranchAddress("detNumber", &fHit.fDetNumber);
+	fChain.SetBranchAddress("cryNumber", &fHit.fCryNumber);
+	fChain.SetBranchAddress("depEnergy", &fHit.fDepEnergy);
+	fChain.SetBranchAddress("posx", &fHit.fPosx);
+	fChain.SetBranchAddress("posy", &fHit.fPosy);
+	fChain.SetBranchAddress("posz", &fHit.fPosz);
+	fChain.SetBranchAddress("time", &fHit.fTime);
+}
+
+Converter::~Converter() {
+	delete fPrefetcher;
+	for(auto configuration : fConfigurations) {
+		delete configuration;
+	}
+}
+
+void Converter::InitChain(bool countEntries) {
+	if(fChainInitialized) {
+		return;
 	}
+	fChainInitialized = true;
 
-	//set tree to belong to output file
-	fEventTree.SetDirectory(fAnalysisFile);
-	if(fWriteFragmentTree) {
-		fFragmentFile = new TFile(Form("fragment%05d_%03d.root", fRunNumber, fSubRunNumber), "recreate");
-		if(!fFragmentFile->IsOpen()) {
-			std::cerr<<"Failed to open file '"<<Form("fragment%05d_%03d.root", fRunNumber, fSubRunNumber)<<"', check permissions on directory and disk space!"<<std::endl;
-			throw;
+	//without a known number of entries, a file is only opened once we read from it
+	if(countEntries) {
+		fEntryCounter.Count(fInputFiles, fSettings->ScanThreads());
+	}
+	fNumberOfEntries = 0;
+	for(const auto& fileName : fInputFiles) {
+		long long entries = fEntryCounter.Entries(fileName);
+		//add sub-directory and tree name to file name
+		if(entries >= 0) {
+			fChain.Add((fileName + fSettings->NtupleName()).c_str(), entries);
+			if(fNumberOfEntries >= 0) {
+				fNumberOfEntries += entries;
+			}
+		} else {
+			fChain.Add((fileName + fSettings->NtupleName()).c_str());
+			fNumberOfEntries = -1;
 		}
-		fFragmentTree.SetDirectory(fFragmentFile);
 	}
+	//only writes the sidecar file if any file had to be counted
+	fEntryCounter.Save();
+}
 
-	//create branches for output tree
-	// GRIFFIN
-	fGriffin = new TGriffin;
-	fEventTree.Branch("TGriffin", &fGriffin, fSettings->BufferSize());
+bool Converter::LoadTree(long int entry) {
+	//-2 means the entry is past the end of the chain (-1 that the chain is empty)
+	//a file that can't be opened (-3) or doesn't contain the tree (-4) is treated as having no entries, so loading the same entry again continues with the next file
+	while(true) {
+		long int result = fChain.LoadTree(entry);
+		if(result >= 0) {
+			return true;
+		}
+		if(result > -3) {
+			return false;
+		}
+		bool newBadFile = false;
+		TObjArray* files = fChain.GetListOfFiles();
+		for(int i = 0; i < files->GetEntries(); ++i) {
+			TChainElement* element = static_cast<TChainElement*>(files->At(i));
+			if(element->GetLoadResult() < 0 && fBadFiles.insert(i).second) {
+				std::cerr<<"Failed to read "<<(element->GetLoadResult() == -3 ? "file '" : "tree from file '")<<element->GetTitle()<<"', skipping it!"<<std::endl;
+				newBadFile = true;
+			}
+		}
+		if(!newBadFile) {
+			std::cerr<<"Failed to load entry "<<entry<<" from chain (error "<<result<<")!"<<std::endl;
+			fChainError = true;
+			return false;
+		}
+	}
+}
 
-	// BGO
-	fGriffinBgo = new TGriffinBgo;
-	fEventTree.Branch("TGriffinBgo", &fGriffinBgo, fSettings->BufferSize());
+bool Converter::WriteCache(const std::string& fileName) {
+	if(fCache.IsOpen()) {
+		std::cerr<<"Can't create a hit cache while reading from a hit cache!"<<std::endl;
+		return false;
+	}
+	//the hit cache needs to know the number of hits before writing them
+	InitChain(true);
 
-	// LaBr
-	fLaBr = new TLaBr;
-	fEventTree.Branch("TLaBr", &fLaBr, fSettings->BufferSize());
+	std::vector<FileIdentity> inputFiles(fInputFiles.size());
+	for(size_t i = 0; i < fInputFiles.size(); ++i) {
+		if(!inputFiles[i].Stat(fInputFiles[i])) {
+			std::cerr<<"Failed to get size and modification time of '"<<fInputFiles[i]<<"', can't create hit cache!"<<std::endl;
+			return false;
+		}
+	}
 
-	// SCEPTAR
-	fSceptar = new TSceptar;
-	fEventTree.Branch("TSceptar", &fSceptar, fSettings->BufferSize());
+	//the cache has to be grouped by event, so unsorted input is read through the event sorter first
+	if(fSettings->EventOrder() == "Unsorted" || (fSettings->EventOrder() == "Auto" && !EventsSorted())) {
+		EventSorter sorter(fSettings->SortBufferSize(), fSettings->SortDirectory(), fSettings->VerbosityLevel());
+		long int nHits = 0;
+		for(long int i = 0; LoadTree(i); ++i) {
+			if(GetEntry(i) <= 0) {
+				std::cerr<<"Error occured, couldn't read entry "<<i<<" from tree "<<fChain.GetName()<<", can't create hit cache"<<std::endl;
+				return false;
+			}
+			if(!sorter.Add(fHit)) {
+				return false;
+			}
+			++nHits;
+		}
+		if(fChainError || !sorter.Finish()) {
+			return false;
+		}
+		return HitCache::Write(nHits, [&sorter](Hit& hit) { return sorter.Next(hit); }, inputFiles, fileName, fSettings->VerbosityLevel());
+	}
 
-	// DESCANT
-	fDescant = new TDescant;
-	fEventTree.Branch("TDescant", &fDescant, fSettings->BufferSize());
+	long int entry = 0;
+	auto next = [this, &entry](Hit& hit) {
+		if(!LoadTree(entry) || GetEntry(entry) <= 0) {
+			return false;
+		}
+		++entry;
+		hit = fHit;
+		return true;
+	};
+	return HitCache::Write(fChain.GetEntries(), next, inputFiles, fileName, fSettings->VerbosityLevel());
+}
 
-	// PACES
-	fPaces = new TPaces;
-	fEventTree.Branch("TPaces", &fPaces, fSettings->BufferSize());
+bool Converter::Run() {
+	auto start = std::chrono::steady_clock::now();
+	bool result;
+	if(!fCache.IsOpen()) {
+		//the number of entries is only needed for the progress output and the metrics
+		InitChain(fSettings->VerbosityLevel() > 0 || fMetrics != nullptr);
+	}
+	if(fCache.IsOpen()) {
+		result = RunCache();
+	} else if(fSettings->EventOrder() == "Unsorted" || (fSettings->EventOrder() == "Auto" && !EventsSorted())) {
+		result = RunSorted();
+	} else {
+		if(fSettings->EventOrder() != "Sorted" && fSettings->EventOrder() != "Auto") {
+			std::cerr<<"Unknown event order \""<<fSettings->EventOrder()<<"\", assuming hits are sorted by event!"<<std::endl;
+		}
+		result = RunChain();
+	}
+	if(!result) {
+		return false;
+	}
 
-	// Fragments
-	fFragment = new TFragment;
-	if(fSettings->VerbosityLevel() > 0) {
-		std::cout<<"created new fragment "<<fFragment<<std::endl;
+	if(fMetrics != nullptr) {
+		fMetrics->Finish(fEvents);
+	}
+
+	if(!fBadFiles.empty()) {
+		std::cerr<<"Warning, skipped "<<fBadFiles.size()<<" of "<<fInputFiles.size()<<" input files that couldn't be read!"<<std::endl;
+	}
+	if(!fSettings->AllSystemsActive()) {
+		std::cout<<"dropped "<<fInactiveHits<<" hits of inactive systems"<<std::endl;
 	}
+	if(fSettings->SamplingEnabled()) {
+		std::cout<<"skipped "<<fSkippedHits<<" hits of events not selected by the sampling"<<std::endl;
+	}
+
+	double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double input = std::chrono::duration<double>(fInputTime).count();
+	std::cout<<"spent "<<input<<" s reading input and "<<total-input<<" s converting"<<std::endl;
 
-	if(fWriteFragmentTree) {
-		fFragmentTree.Branch("Fragment", &fFragment, fSettings->BufferSize());
+	if(fSettings->VerbosityLevel() > 0) {
+		std::cout<<"100% done"<<std::endl;
+	}
+	for(auto configuration : fConfigurations) {
+		configuration->PrintStatistics();
 	}
+	AllocationCounter::Print(fEvents, fHits);
+
+	return true;
 }
 
-Converter::~Converter() {
-	if(fAnalysisFile->IsOpen()) {
-		fAnalysisFile->cd();
-		fEventTree.Write("AnalysisTree");
-		fRunInfo->Write("RunInfo");
-		TChannel::WriteToRoot();
-		fAnalysisFile->Close();
-	}
-	if(fWriteFragmentTree) {
-		if(fFragmentFile->IsOpen()) {
-			fFragmentFile->cd();
-			fFragmentTree.Write("FragmentTree");
-			fRunInfo->Write("RunInfo");
-			TChannel::WriteToRoot();
-			fFragmentFile->Close();
+bool Converter::Estimate(long int nEvents) {
+	if(fCache.IsOpen()) {
+		std::cerr<<"Estimates can only be made from the input files, not from a hit cache!"<<std::endl;
+		return false;
+	}
+	InitChain(true);
+	if(fNumberOfEntries <= 0 || nEvents <= 0) {
+		std::cerr<<"Need at least one entry and one event to estimate the conversion ("<<fNumberOfEntries<<" entries, "<<nEvents<<" events)!"<<std::endl;
+		return false;
+	}
+	if(fSettings->EventOrder() != "Sorted") {
+		std::cerr<<"Warning, the estimate doesn't include the time needed to group hits by event!"<<std::endl;
+	}
+
+	//the sample is split into blocks of contiguous events, the spread between blocks gives the uncertainty of the estimate
+	long int nBlocks = std::min(20L, nEvents);
+	std::vector<double> timePerHit;
+	long int sampledHits = 0;
+	long int sampledEvents = 0;
+	double sampledTime = 0.;
+	for(long int block = 0; block < nBlocks; ++block) {
+		long int entry = fNumberOfEntries*block/nBlocks;
+		//the first blocks get one more event each, so all nEvents are sampled
+		long int eventsPerBlock = nEvents/nBlocks + (block < nEvents%nBlocks ? 1 : 0);
+		//skip the rest of the event the block starts in
+		if(block > 0 && LoadTree(entry) && GetEntry(entry) > 0) {
+			int eventNumber = fHit.fEventNumber;
+			while(LoadTree(entry) && GetEntry(entry) > 0 && fHit.fEventNumber == eventNumber) {
+				++entry;
+			}
+		}
+		auto start = std::chrono::steady_clock::now();
+		long int hits = 0;
+		long int events = 0;
+		for(; LoadTree(entry); ++entry) {
+			if(GetEntry(entry) <= 0) {
+				continue;
+			}
+			if(hits == 0 || fHit.fEventNumber != fLastEventNumber) {
+				if(events == eventsPerBlock) {
+					break;
+				}
+				++events;
+			}
+			AddHit();
+			++hits;
+		}
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if(hits > 0) {
+			timePerHit.push_back(elapsed/hits);
+		}
+		sampledHits += hits;
+		sampledEvents += events;
+		sampledTime += elapsed;
+		if(fSettings->VerbosityLevel() > 0) {
+			std::cout<<"block "<<block<<": "<<events<<" events, "<<hits<<" hits in "<<elapsed<<" s"<<std::endl;
+		}
+	}
+	for(auto configuration : fConfigurations) {
+		configuration->Flush();
+	}
+	if(fChainError) {
+		return false;
+	}
+	if(sampledHits == 0 || sampledEvents == 0) {
+		std::cerr<<"Failed to read any hits for the estimate!"<<std::endl;
+		return false;
+	}
+
+	//mean time per hit and 95% confidence interval from the spread of the blocks
+	double mean = 0.;
+	for(auto time : timePerHit) {
+		mean += time;
+	}
+	mean /= timePerHit.size();
+	double halfWidth = 0.;
+	if(timePerHit.size() > 1) {
+		double variance = 0.;
+		for(auto time : timePerHit) {
+			variance += (time - mean)*(time - mean);
 		}
+		variance /= timePerHit.size() - 1;
+		halfWidth = StudentT95(timePerHit.size() - 1)*std::sqrt(variance/timePerHit.size());
+	}
+	double hitsPerEvent = static_cast<double>(sampledHits)/sampledEvents;
+	double totalEvents = fNumberOfEntries/hitsPerEvent;
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	std::cout<<"estimate from "<<sampledEvents<<" events ("<<sampledHits<<" hits) in "<<timePerHit.size()<<" blocks, "<<sampledTime<<" s, ranges are 95% confidence intervals:"<<std::endl
+	         <<"  total hits:   "<<fNumberOfEntries<<std::endl
+	         <<"  total events: "<<static_cast<long int>(totalEvents)<<" ("<<hitsPerEvent<<" hits/event)"<<std::endl
+	         <<"  wall time:    "<<fNumberOfEntries*mean<<" s ["<<fNumberOfEntries*std::max(mean - halfWidth, 0.)<<", "<<fNumberOfEntries*(mean + halfWidth)<<"]"<<std::endl
+	         <<"  hits/s:       "<<1./mean<<" ["<<1./(mean + halfWidth)<<", "<<(mean > halfWidth ? 1./(mean - halfWidth) : 0.)<<"]"<<std::endl
+	         <<"  events/s:     "<<1./mean/hitsPerEvent<<" ["<<1./(mean + halfWidth)/hitsPerEvent<<", "<<(mean > halfWidth ? 1./(mean - halfWidth)/hitsPerEvent : 0.)<<"]"<<std::endl;
+	//the output is compressed per basket, so its size is only known for the whole sample
+	for(size_t i = 0; i < fConfigurations.size(); ++i) {
+		double bytesPerEvent = static_cast<double>(fConfigurations[i]->OutputBytes())/sampledEvents;
+		std::cout<<"  output #"<<i<<":    "<<bytesPerEvent<<" bytes/event, "<<bytesPerEvent*totalEvents/1024./1024.<<" MB in total"<<std::endl;
+	}
+	std::cout<<"  peak memory:  "<<usage.ru_maxrss/1024.<<" MB";
+	if(fSettings->EventOrder() != "Sorted") {
+		std::cout<<" (plus up to "<<fSettings->SortBufferSize()*sizeof(Hit)/1024./1024.<<" MB to group hits by event)";
 	}
+	std::cout<<std::endl;
+
+	return true;
 }
 
-int Converter::Cfd(EDigitizer digitizer)
-{
-   switch(digitizer) {
-		case EDigitizer::kGRF16:
-			// cfd is in 10/16th of a nanosecond, and replaces the lowest 18 bit of timestamp
-			// so multiply the time by 16e8, and use only the lowest 22 bit
-			return static_cast<int>(fTime*16e8)&0x3fffff;
-		case EDigitizer::kGRF4G:
-			{
-			// calculate cfd (0 - 8 ns) in 1/256 ns
-			int cfd = fTime*256e9;
-			cfd = cfd%1024;//1024 = 256 steps for 0 - 8 ns
-			// calculate remainder between 8 ns timestamp and 10 ns timestamp
-			int rem = fTime*1e9;
-			rem = rem%40;
-			if(rem < 8)       rem = 0;
-			else if(rem < 16) rem = 8;
-			else if(rem < 24) rem = 6;
-			else if(rem < 32) rem = 4;
-			else              rem = 2;
-			return (rem << 22) | cfd;
-			}
-		case EDigitizer::kTIG10:
-			// cfd is in 10/16th of a nanosecond, and replaces the lowest 23 bit of timestamp
-			return static_cast<int>(fTime*16e8)&0x7ffffff;
-		default:
-			return 0;
+double Converter::StudentT95(int degreesOfFreedom) {
+	//two-sided 95% quantile of the Student t-distribution, tabulated for few degrees of freedom where the expansion below is too small
+	static const double table[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	                                 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	                                 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+	if(degreesOfFreedom >= 1 && degreesOfFreedom <= 30) {
+		return table[degreesOfFreedom-1];
 	}
+	//Cornish-Fisher expansion around the normal quantile
+	double z = 1.959964;
+	double n = degreesOfFreedom;
+	return z + (z*z*z + z)/(4.*n) + (5.*std::pow(z, 5) + 16.*z*z*z + 3.*z)/(96.*n*n);
 }
 
-bool Converter::Run() {
+bool Converter::RunChain() {
 	int status;
-	int eventNumber = 0;
+	int treeNumber = -1;
+	int lastEventNumber = 0;
+	long int outOfOrder = 0;
 
-	float smearedEnergy;
-	std::map<int,int> belowThreshold;
-	std::map<int,int> outsideTimeWindow;
+	long int nEntries = fNumberOfEntries;
 
-	long int nEntries = fChain.GetEntries();
+	if(fMetrics != nullptr) {
+		fMetrics->SetTotalEntries(nEntries);
+	}
 
-	TChannel* channel;
-	uint32_t address;
-	std::string mnemonic;
-	std::string crystalColor = "BGRW";
-	std::string digitizerType;
-	for(int i = 0; i < nEntries; ++i) {
-		status = fChain.GetEntry(i);
+	for(long int i = 0; LoadTree(i); ++i) {
+		//hits of events that aren't selected are skipped after reading only the event number
+		if(fSettings->SamplingEnabled() && GetEventNumber(i) && !Selected(fHit.fEventNumber)) {
+			++fSkippedHits;
+			continue;
+		}
+		status = GetEntry(i);
 		if(status == -1) {
 			std::cerr<<"Error occured, couldn't read entry "<<i<<" from tree "<<fChain.GetName()<<" in file "<<fChain.GetFile()->GetName()<<std::endl;
 			continue;
@@ -174,319 +391,240 @@ bool Converter::Run() {
 			return false;
 		}
 
-		//if this entry is from the next event, we fill the tree with everything we've collected so far and reset the vector(s)
-		if((fEventNumber != eventNumber) && ((fSettings->SortNumberOfEvents()==0)||(fSettings->SortNumberOfEvents()>=eventNumber))) {
-			if(fSettings->VerbosityLevel() > 2) {
-				std::cout<<eventNumber<<": "<<fFragments.size()<<" fragments, "<<belowThreshold.size()<<" addresses below treshold, "<<outsideTimeWindow.size()<<" addresses outside time window"<<std::endl;
-			}
-			// this takes the fragments we have collected and adds them to the detector classes
-			// it also automatically fills the fragment tree
-			FillDetectors();
+		//count event numbers going backwards within one file, those events are split up
+		if(fChain.GetTreeNumber() == treeNumber && fHit.fEventNumber < lastEventNumber) {
+			++outOfOrder;
+		}
+		treeNumber = fChain.GetTreeNumber();
+		lastEventNumber = fHit.fEventNumber;
+
+		AddHit();
+
+		if(i%1000 == 0 && fSettings->VerbosityLevel() > 0 && nEntries > 0) {
+			std::cout<<std::setw(3)<<100*i/nEntries<<"% done\r"<<std::flush;
+		}
+		if(i%1000 == 0 && fMetrics != nullptr) {
+			fMetrics->SetInputFile(fChain.GetFile()->GetName());
+			if(fPrefetcher != nullptr) fMetrics->SetQueueDepth("prefetch", fPrefetcher->Pending());
+			fMetrics->Update(i, fEvents);
+		}
+	}
 
-			fEventTree.Fill(); // Tree contains suppressed data
+	if(fChainError) {
+		return false;
+	}
+
+	if(outOfOrder > 0) {
+		std::cerr<<std::endl<<"Warning, event numbers decreased "<<outOfOrder<<" times within an input file, events have been split up! Use \"EventOrder: Unsorted\" in the settings file to group hits by event."<<std::endl;
+	}
 
-			fGriffin->Clear();
-			fGriffinBgo->Clear();
-			fLaBr->Clear();
-			fSceptar->Clear();
-			fDescant->Clear();
-			fPaces->Clear();
+	return true;
+}
 
-			eventNumber = fEventNumber;
-			belowThreshold.clear();
-			outsideTimeWindow.clear();
+bool Converter::EventsSorted() {
+	//only read the event number branch to check whether the hits of each event are contiguous
+	bool sorted = true;
 
-			fFragments.clear();
+	fChain.SetBranchStatus("*", false);
+	fChain.SetBranchStatus("eventNumber", true);
+	int lastEventNumber = 0;
+	for(long int i = 0; LoadTree(i); ++i) {
+		if(fChain.GetEntry(i) <= 0) {
+			continue;
 		}
+		if(i > 0 && fHit.fEventNumber < lastEventNumber) {
+			sorted = false;
+			break;
+		}
+		lastEventNumber = fHit.fEventNumber;
+	}
+	fChain.SetBranchStatus("*", true);
+
+	if(fSettings->VerbosityLevel() > 0 || !sorted) {
+		std::cout<<"hits are "<<(sorted ? "" : "not ")<<"sorted by event number"<<std::endl;
+	}
+
+	return sorted;
+}
+
+bool Converter::RunSorted() {
+	int status;
 
-		// if fSystemID is NOT GRIFFIN, then set fCryNumber to zero
-		// This is a quick fix to solve resolution and threshold values from Settings.cc
-		if(fSystemID >= 2000) {
-			fCryNumber = 0;
+	long int nEntries = fNumberOfEntries;
+
+	EventSorter sorter(fSettings->SortBufferSize(), fSettings->SortDirectory(), fSettings->VerbosityLevel());
+
+	//each hit is counted twice, once when it is read and once when it is converted
+	if(fMetrics != nullptr) {
+		fMetrics->SetTotalEntries(2*nEntries);
+	}
+
+	long int nRead = 0;
+	for(long int i = 0; LoadTree(i); ++i) {
+		//hits of events that aren't selected are skipped after reading only the event number
+		if(fSettings->SamplingEnabled() && GetEventNumber(i) && !Selected(fHit.fEventNumber)) {
+			++fSkippedHits;
+			continue;
 		}
-		//create energy-resolution smeared energy
-		if(fSettings->DontSmearEnergy()) {
-			smearedEnergy = fDepEnergy;
-		} else {
-			smearedEnergy = fRandom.Gaus(fDepEnergy, fSettings->Resolution(fSystemID,fDetNumber,fCryNumber,fDepEnergy));
-		}
-
-		if((fSettings->SortNumberOfEvents()==0)||(fSettings->SortNumberOfEvents()>=fEventNumber) ) {
-			//if the hit is above the threshold, we add it to the vector
-			if(AboveThreshold(smearedEnergy, fSystemID)) {
-				if(InsideTimeWindow() ) {
-					switch(fSystemID) {
-						//mapping systems to address ranges: 0 - GRIFFIN, 1 - BGO, 2 - LaBr, 3 - ancilliary BGO, 4 - NaI, 5 - SCEPTAR, 6 - SPICE, 7 - PACES, 8 - DESCANT
-						case 1000://griffin
-							address = 4*fDetNumber + fCryNumber;
-							break;
-						case 1010://left extension suppressor
-						case 1020://right extension suppressor
-						case 1030://left casing suppressor
-						case 1040://right casing suppressor
-						case 1050://back suppressor
-							address = 1000 + 10*fDetNumber + fCryNumber;
-							break;
-						case 10://SPICE
-							address = 6000 + fDetNumber;
-							break;
-						case 50://PACES
-							address = 7000 + fDetNumber;
-							break;
-						case 6000://8pi
-						case 6010://8pi inner BGO
-						case 6020://8pi outer BGO
-							std::cerr<<"Sorry, 8pi is not implemented in GRSISort!"<<std::endl;
-							throw;
-						case 7000:
-							std::cerr<<"Sorry, gridcell is not implemented in GRSISort!"<<std::endl;
-							throw;
-						// DESCANT: detectors are numbered 1-x for each color
-						// until I figure out which one goes where, I'll just add them up
-						case 8010://blue
-							//fDetNumber += 10; // 10 green detectors
-						case 8020://green
-							//fDetNumber += 15; // 15 red detectors
-						case 8030://red
-							//fDetNumber += 20; // 20 white detectors
-						case 8040://white
-							//fDetNumber += 10; // 10 yellow detectors
-						case 8050://yellow
-							if(fDetNumber < 16) {
-								address = 0x8400 + fDetNumber;
-							} else if(fDetNumber < 32) {
-								address = 0x8800 + fDetNumber - 16;
-							} else if(fDetNumber < 48) {
-								address = 0x8c00 + fDetNumber - 32;
-							} else if(fDetNumber < 59) {
-								address = 0x9000 + fDetNumber - 48;
-							} else {
-								address = 0x9400 + fDetNumber - 59;
-							}
-							break;
-						case 8500://testcan
-							std::cerr<<"Sorry, testcan is not implemented in GRSISort!"<<std::endl;
-							throw;
-						default: //2000 - LaBr, 3000 - ancillary BGO, 4000 - NaI, 5000 - Sceptar
-							address = fSystemID + fDetNumber;
-							break;
-					}
-					if(fFragments.count(address) == 1) {
-						// add charge
-						fFragments[address].SetCharge(fFragments[address].GetCharge()+smearedEnergy*fKValue);
-						// update timestamp
-						fFragments[address].SetTimeStamp(fTime*1e8);
-					} else {
-						fFragments[address].SetAddress(address);
-						//fFragments[address].SetCcLong();
-						//fFragments[address].SetCcShort();
-						fFragments[address].SetCfd(0);
-						fFragments[address].SetCharge(smearedEnergy*fKValue);
-						fFragments[address].SetKValue(fKValue);
-						//fFragments[address].SetMidasId(fFragmentTreeEntries);
-						// fTime is the time from the beginning of the event in seconds
-						fFragments[address].SetDaqTimeStamp(fTime); 
-						fFragments[address].SetTimeStamp(fTime*1e8);
-						//fFragments[address].SetZc();
-						++fFragmentTreeEntries;
-						//check if the channel for this address exists, and if not create one and add it to the map
-						channel = TChannel::GetChannel(address);
-						if(channel == nullptr) {
-                            // simulation outputs detector numbers [0,15] but we want [1,16] for
-                            // assigning mnemonics
-                            ++fDetNumber;
-
-							switch(fSystemID) {
-								case 1000://griffin
-									mnemonic = Form("GRG%02d%cN00A", fDetNumber, crystalColor[fCryNumber]);
-									digitizerType = "GRF16";
-									fFragments[address].SetCfd(Cfd(EDigitizer::kGRF16));
-									break;
-								case 1010://left extension suppressor
-								case 1020://right extension suppressor
-								case 1030://left casing suppressor
-								case 1040://right casing suppressor
-								case 1050://back suppressor
-									mnemonic = Form("GRS%02d%cN00A", fDetNumber, crystalColor[fCryNumber]);
-									digitizerType = "GRF16";
-									fFragments[address].SetCfd(Cfd(EDigitizer::kGRF16));
-									break;
-								case 2000://LABr
-									mnemonic = Form("DAL%02dXN00X", fDetNumber);
-									digitizerType = "GRF16";
-									fFragments[address].SetCfd(Cfd(EDigitizer::kGRF16));
-									break;
-								case 3000://ancilliary BGO
-									mnemonic = Form("DAS%02dXN00X", fDetNumber);
-									digitizerType = "GRF16";
-									fFragments[address].SetCfd(Cfd(EDigitizer::kGRF16));
-									break;
-								case 5000://SCEPTAR
-									mnemonic = Form("SEP%02dXN00X", fDetNumber);
-									digitizerType = "GRF16";
-									fFragments[address].SetCfd(Cfd(EDigitizer::kGRF16));
-									break;
-								case 10://SPICE
-									mnemonic = Form("SPI%02dXN%0dX", fDetNumber, fCryNumber);//TODO: fix SPICE mnemonic
-									break;
-								case 50://PACES
-									mnemonic = Form("PAC%02dXN00A", fDetNumber);
-									fFragments[address].SetCfd(Cfd(EDigitizer::kGRF16));
-									break;
-								case 8010://blue
-								case 8020://green
-								case 8030://red
-								case 8040://white
-								case 8050://yellow
-									mnemonic = Form("DSC%02dXN00X", fDetNumber);
-									digitizerType = "CAEN";
-									fFragments[address].SetCfd(Cfd(EDigitizer::kGRF16));
-									break;
-								default: 
-									std::cerr<<"Sorry, unknown system ID "<<fSystemID<<std::endl;
-									throw;
-							}
-							channel = new TChannel;
-							channel->SetAddress(address);
-							channel->SetName(mnemonic.c_str());
-							channel->SetDetectorNumber(fDetNumber);
-							channel->SetCrystalNumber(fCryNumber);
-							channel->SetDigitizerType(TPriorityValue<std::string>(digitizerType, EPriority::kRootFile));
-							TChannel::AddChannel(channel);
-						}
-						if(fSettings->VerbosityLevel() > 1) {
-							std::cout<<"Initialized values of fragment at address "<<address<<" = 0x"<<std::hex<<address<<std::dec<<std::endl;
-							fFragments[address].Print();
-						}
-					}
-				} else {
-					++outsideTimeWindow[fSystemID];
-				}
-			} else {
-				++belowThreshold[fSystemID];
-			}
+		status = GetEntry(i);
+		if(status == -1) {
+			std::cerr<<"Error occured, couldn't read entry "<<i<<" from tree "<<fChain.GetName()<<" in file "<<fChain.GetFile()->GetName()<<std::endl;
+			continue;
+		} else if(status == 0) {
+			std::cerr<<"Error occured, entry "<<i<<" in tree "<<fChain.GetName()<<" in file "<<fChain.GetFile()->GetName()<<" doesn't exist"<<std::endl;
+			return false;
 		}
 
-		if(i%1000 == 0 && fSettings->VerbosityLevel() > 0) {
-			std::cout<<std::setw(3)<<100*i/nEntries<<"% done\r"<<std::flush;
+		//hits of inactive systems don't need to be sorted
+		if(!fSettings->HitActive(fHit.fSystemID)) {
+			++fInactiveHits;
+			continue;
+		}
+		if(!sorter.Add(fHit)) {
+			return false;
+		}
+		++nRead;
+
+		if(i%1000 == 0 && fSettings->VerbosityLevel() > 0 && nEntries > 0) {
+			std::cout<<std::setw(3)<<50*i/nEntries<<"% done\r"<<std::flush;
+		}
+		if(i%1000 == 0 && fMetrics != nullptr) {
+			fMetrics->SetInputFile(fChain.GetFile()->GetName());
+			fMetrics->SetQueueDepth("sort_buffer", sorter.BufferedHits());
+			fMetrics->SetQueueDepth("sort_runs", sorter.NumberOfRuns());
+			if(fPrefetcher != nullptr) fMetrics->SetQueueDepth("prefetch", fPrefetcher->Pending());
+			fMetrics->Update(i, fEvents);
 		}
 	}
 
-	if(fSettings->VerbosityLevel() > 0) {
-		std::cout<<"100% done"<<std::endl;
-		if(fSettings->VerbosityLevel() > 1) {
-			PrintStatistics();
+	if(fChainError || !sorter.Finish()) {
+		return false;
+	}
+	//now we know how many hits there are
+	nEntries = nRead;
+	if(fMetrics != nullptr) {
+		fMetrics->SetTotalEntries(2*nEntries);
+	}
+
+	//hits are now returned grouped by event number
+	for(long int i = 0; sorter.Next(fHit); ++i) {
+		AddHit();
+
+		if(i%1000 == 0 && fSettings->VerbosityLevel() > 0 && nEntries > 0) {
+			std::cout<<std::setw(3)<<50+50*i/nEntries<<"% done\r"<<std::flush;
+		}
+		if(i%1000 == 0 && fMetrics != nullptr) {
+			fMetrics->SetQueueDepth("sort_buffer", sorter.BufferedHits());
+			fMetrics->Update(nEntries+i, fEvents);
 		}
 	}
 
 	return true;
 }
 
-void Converter::FillDetectors() {
-	for(auto frag : fFragments) {
-		if(fWriteFragmentTree) {
-			*fFragment = frag.second;
-			fFragmentTree.Fill();
-		}
-		TChannel* channel = TChannel::GetChannel(frag.second.GetAddress());
-		switch(frag.second.GetAddress()/1000) {
-			//mapping systems to address ranges: 0 - GRIFFIN, 1 - BGO, 2 - LaBr, 3 - ancilliary BGO, 4 - NaI, 5 - SCEPTAR, 6 - SPICE, 7 - PACES, 8 - DESCANT
-			case 0:
-				fGriffin->AddFragment(std::make_shared<TFragment>(frag.second), channel);
-				if(fSettings->VerbosityLevel() > 2) {
-					std::cout<<"Added fragment "<<fFragment<<" to griffin:"<<std::endl;
-					fFragment->Print();
-				}
-				break;
-			case 1:
-			case 3:
-				fGriffinBgo->AddFragment(std::make_shared<TFragment>(frag.second), channel);
-				if(fSettings->VerbosityLevel() > 2) {
-					std::cout<<"Added fragment "<<fFragment<<" to bgo:"<<std::endl;
-					fFragment->Print();
-				}
-				break;
-			case 2:
-				fLaBr->AddFragment(std::make_shared<TFragment>(frag.second), channel);
-				if(fSettings->VerbosityLevel() > 2) {
-					std::cout<<"Added fragment "<<fFragment<<" to labr:"<<std::endl;
-					fFragment->Print();
-				}
-				break;
-			case 5:
-				fSceptar->AddFragment(std::make_shared<TFragment>(frag.second), channel);
-				if(fSettings->VerbosityLevel() > 2) {
-					std::cout<<"Added fragment "<<fFragment<<" to sceptar:"<<std::endl;
-					fFragment->Print();
-				}
-				break;
-			case 7:
-				fPaces->AddFragment(std::make_shared<TFragment>(frag.second), channel);
-				if(fSettings->VerbosityLevel() > 2) {
-					std::cout<<"Added fragment "<<fFragment<<" to paces:"<<std::endl;
-					fFragment->Print();
-				}
-				break;
-			case 33:
-			case 34:
-			case 35:
-			case 36:
-			case 37:
-				fDescant->AddFragment(std::make_shared<TFragment>(frag.second), channel);
-				if(fSettings->VerbosityLevel() > 2) {
-					std::cout<<"Added fragment "<<fFragment<<" to descant:"<<std::endl;
-					fFragment->Print();
-				}
-				break;
+bool Converter::RunCache() {
+	uint64_t nHits = fCache.NumberOfHits();
+	uint64_t nEvents = fCache.NumberOfEvents();
 
-			default:
-				if(fSettings->VerbosityLevel() > 1) {
-					std::cerr<<"Unknown address "<<frag.second.GetAddress()<<" = 0x"<<std::hex<<frag.second.GetAddress()<<std::dec<<std::endl;
-					frag.second.Print();
-				}
-				break;
-		}
+	if(fMetrics != nullptr) {
+		fMetrics->SetTotalEntries(nHits);
 	}
-}
 
-bool Converter::AboveThreshold(double energy, int systemID) {
-	if(systemID == 5000) {
-		// apply hard threshold of 50 keV on Sceptar
-		// SCEPTAR in reality saturates at an efficiency of about 80%. In simulation we get an efficiency of 90%
-		// 0.9 * 1.11111111 = 100%, 0.8*1.1111111 = 0.888888888
-		if(energy > 50.0 && (fRandom.Uniform(0.,1.) < 0.88888888 )) {
-			return true;
-		} else {
-			return false;
+	//the cache only stores the branches we need, all others stay zero
+	for(uint64_t event = 0; event < nEvents; ++event) {
+		fHit.fEventNumber = fCache.EventNumber(event);
+		if(fSettings->SamplingEnabled() && !Selected(fHit.fEventNumber)) {
+			fSkippedHits += fCache.LastHit(event) - fCache.FirstHit(event);
+			continue;
 		}
-	} else if(energy > fSettings->Threshold(fSystemID,fDetNumber,fCryNumber)+10*fSettings->ThresholdWidth(fSystemID,fDetNumber,fCryNumber)) {
-		return true;
-	}
+		for(uint64_t i = fCache.FirstHit(event); i < fCache.LastHit(event); ++i) {
+			fCache.GetHit(i, fHit);
+			AddHit();
 
-	if(fRandom.Uniform(0.,1.) < 0.5*(TMath::Erf((energy-fSettings->Threshold(fSystemID,fDetNumber,fCryNumber))/fSettings->ThresholdWidth(fSystemID,fDetNumber,fCryNumber))+1)) {
-		return true;
+			if(i%1000 == 0 && fSettings->VerbosityLevel() > 0) {
+				std::cout<<std::setw(3)<<100*i/nHits<<"% done\r"<<std::flush;
+			}
+			if(i%1000 == 0 && fMetrics != nullptr) {
+				fMetrics->Update(i, fEvents);
+			}
+		}
 	}
 
-	return false;
+	return true;
 }
 
-bool Converter::InsideTimeWindow() {
-	if(fSettings->TimeWindow(fSystemID,fDetNumber,fCryNumber) == 0) {
-		return true;
+void Converter::AddHit() {
+	if(!fSettings->HitActive(fHit.fSystemID)) {
+		++fInactiveHits;
+		return;
 	}
-	if(fTime < fSettings->TimeWindow(fSystemID,fDetNumber,fCryNumber)) {
-		return true;
+	if(fEvents == 0 || fHit.fEventNumber != fLastEventNumber) {
+		++fEvents;
+		fLastEventNumber = fHit.fEventNumber;
+		//channels, output baskets, and buffers are created during the first events, after that nothing should be allocated
+		if(fEvents == kWarmUpEvents) {
+			AllocationCounter::StartSteadyState(fEvents, fHits);
+		}
+	}
+	++fHits;
+	//the hit is unpacked once and each configuration applies its own response to it
+	for(auto configuration : fConfigurations) {
+		configuration->AddHit(fHit);
 	}
-	return false;
 }
 
-bool Converter::DescantNeutronDiscrimination() { // Assuming perfect gamma-neutron discrimination
-	if(fParticleType == 5) { // neutron
-		return true;
+bool Converter::GetEventNumber(long int entry) {
+	AllocationCounter stage(EAllocationStage::kRead);
+	long int localEntry = fChain.LoadTree(entry);
+	if(localEntry < 0) {
+		return false;
+	}
+	if(fChain.GetTreeNumber() != fEventNumberTree) {
+		fEventNumberTree = fChain.GetTreeNumber();
+		fEventNumberBranch = fChain.GetTree()->GetBranch("eventNumber");
+	}
+	if(fEventNumberBranch == nullptr) {
+		return false;
 	}
-	return false;
+	auto start = std::chrono::steady_clock::now();
+	int status = fEventNumberBranch->GetEntry(localEntry);
+	fInputTime += std::chrono::steady_clock::now() - start;
+	return status > 0;
 }
 
-void Converter::PrintStatistics() {
+bool Converter::Selected(int eventNumber) {
+	//the selection only depends on the event number and the seed, so hits of the same event are always selected together,
+	//independent of the order in which they are read
+	if(fSettings->SamplePrescale() > 1 && eventNumber%fSettings->SamplePrescale() != 0) {
+		return false;
+	}
+	if(fSettings->SampleFraction() < 1.) {
+		//splitmix64 hash of seed and event number, converted to a uniform number in [0, 1)
+		uint64_t hash = fSettings->SampleSeed() + 0x9e3779b97f4a7c15ULL*(static_cast<uint64_t>(eventNumber) + 1);
+		hash = (hash ^ (hash >> 30))*0xbf58476d1ce4e5b9ULL;
+		hash = (hash ^ (hash >> 27))*0x94d049bb133111ebULL;
+		hash ^= hash >> 31;
+		return (hash >> 11)*(1./9007199254740992.) < fSettings->SampleFraction();
+	}
+	return true;
 }
 
+int Converter::GetEntry(long int entry) {
+	AllocationCounter stage(EAllocationStage::kRead);
+	auto start = std::chrono::steady_clock::now();
+	int status = fChain.GetEntry(entry);
+	fInputTime += std::chrono::steady_clock::now() - start;
+
+	//once we start reading a new file, we add all branches to its cache and read the next file ahead
+	if(fChain.GetTreeNumber() != fTreeNumber) {
+		fTreeNumber = fChain.GetTreeNumber();
+		if(fSettings->TreeCacheSizeMB() > 0) {
+			fChain.AddBranchToCache("*", true);
+		}
+		if(fPrefetcher != nullptr && fTreeNumber >= 0 && fTreeNumber+1 < static_cast<int>(fInputFiles.size())) {
+			fPrefetcher->Prefetch(fInputFiles[fTreeNumber+1]);
+		}
+	}
+
+	return status;
+}
@@ -2,90 +2,81 @@
 #define __CONVERTER_HH
 
 #include <vector>
+#include <set>
+#include <chrono>
 
 #include "TChain.h"
-#include "TFile.h"
-#include "TTree.h"
-#include "TRandom3.h"
 #include "TVector3.h"
 
-#include "TRunInfo.h"
-#include "TChannel.h"
-#include "TFragment.h"
-#include "TGriffin.h"
-#include "TGriffinBgo.h"
-#include "TSceptar.h"
-#include "TPaces.h"
-#include "TLaBr.h"
-#include "TDescant.h"
-
 #include "Settings.hh"
+#include "Hit.hh"
+#include "HitCache.hh"
+#include "EventSorter.hh"
+#include "Metrics.hh"
+#include "FilePrefetcher.hh"
+#include "EntryCounter.hh"
+#include "Configuration.hh"
 
 class Converter {
 public:
-	Converter(std::vector<std::string>& inputFileNames, const int& runNumber, const int& subRunNumber, const TRunInfo* runInfo, Settings* settings, bool writeFragmentTree);
+	Converter(std::vector<std::string>& inputFileNames, Settings* settings, const std::string& cacheFileName = "");
 	~Converter();
 
+	// the converter takes ownership of the configuration
+	void AddConfiguration(Configuration* configuration) { fConfigurations.push_back(configuration); }
+
+	void SetMetrics(Metrics* metrics) { fMetrics = metrics; }
+
+	bool WriteCache(const std::string& fileName);
+
 	bool Run();
+	// converts a sample of events spread across the input and extrapolates time and output size of the full conversion
+	bool Estimate(long int nEvents);
 
 private:
-	int  Cfd(EDigitizer);
-	bool AboveThreshold(double, int);
-	bool InsideTimeWindow();
-	bool DescantNeutronDiscrimination();
-	void FillDetectors();
-
-	void PrintStatistics();
+	void InitChain(bool countEntries);
+	// loads the tree of this entry, input files that can't be read are reported and skipped
+	// returns false after the last entry (or if the chain can't be loaded at all, which sets fChainError)
+	bool LoadTree(long int entry);
+	bool RunChain();
+	bool RunCache();
+	bool RunSorted();
+	bool EventsSorted();
+	void AddHit();
+	int GetEntry(long int entry);
+	static double StudentT95(int degreesOfFreedom);
+	// reads only the event number of this entry
+	bool GetEventNumber(long int entry);
+	bool Selected(int eventNumber);
 
 	Settings* fSettings;
 	TChain fChain;
-	TFile* fFragmentFile;
-	TFile* fAnalysisFile;
-	TTree fEventTree;
-	TFragment* fFragment;
-	std::map<uint32_t, TFragment> fFragments;
-	bool fWriteFragmentTree;
-	TTree fFragmentTree;
-	int fFragmentTreeEntries;
-	int fRunNumber;
-	int fSubRunNumber;
-	const TRunInfo* fRunInfo;
-	int fKValue;
-	TRandom3 fRandom;
+	std::vector<std::string> fInputFiles;
+	EntryCounter fEntryCounter;
+	bool fChainInitialized;
+	// total number of entries in the chain, -1 if the number of entries of any file is unknown
+	long int fNumberOfEntries;
+	// index (in the chain) of input files that couldn't be opened or don't contain the tree
+	std::set<int> fBadFiles;
+	bool fChainError;
+	FilePrefetcher* fPrefetcher;
+	int fTreeNumber;
+	// event number branch of the current tree, used to skip events not selected by the sampling
+	TBranch* fEventNumberBranch;
+	int fEventNumberTree;
+	long int fSkippedHits;
+	long int fInactiveHits;
+	std::chrono::steady_clock::duration fInputTime;
+	HitCache fCache;
+	// one configuration per settings file, each hit read from the chain is passed to all of them
+	std::vector<Configuration*> fConfigurations;
+	Metrics* fMetrics;
+	long int fEvents;
+	long int fHits;
+	static const long int kWarmUpEvents = 1000;
+	int fLastEventNumber;
 
 	//branches of input tree/chain
-	Int_t fEventNumber;
-	Int_t fTrackID;
-	Int_t fParentID;
-	Int_t fStepNumber;
-	Int_t fParticleType;
-	Int_t fProcessType;
-	Int_t fSystemID;
-	Int_t fCryNumber;
-	Int_t fDetNumber;
-	Double_t fDepEnergy;
-	Double_t fPosx;
-	Double_t fPosy;
-	Double_t fPosz;
-	Double_t fTime;
-
-	//branches of output tree
-	// GRIFFIN
-	TGriffin* fGriffin;
-
-	// BGO
-	TGriffinBgo* fGriffinBgo;
-
-	// LaBr
-	TLaBr* fLaBr;
-
-	// Sceptar
-	TSceptar* fSceptar;
-
-	// Descant
-	TDescant* fDescant;
-
-	// Paces
-	TPaces* fPaces;
+	Hit fHit;
 };
 #endif
@@ -0,0 +1,117 @@
+#include "EntryCounter.hh"
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+
+#include "TROOT.h"
+#include "TFile.h"
+#include "TTree.h"
+
+EntryCounter::EntryCounter(const std::string& sidecarFileName, const std::string& treeName, int verbosityLevel)
+	: fSidecarFileName(sidecarFileName), fTreeName(treeName), fVerbosityLevel(verbosityLevel)
+{
+	//the ntuple name from the settings starts with a slash, which isn't needed to get the tree from the file
+	if(!fTreeName.empty() && fTreeName[0] == '/') {
+		fTreeName.erase(0, 1);
+	}
+
+	if(fSidecarFileName.empty()) {
+		return;
+	}
+	//each line has the number of entries, size, modification time, and path of one file
+	FileList::Read(fSidecarFileName, fFiles);
+	if(fVerbosityLevel > 0) {
+		std::cout<<"read number of entries of "<<fFiles.size()<<" files from "<<fSidecarFileName<<std::endl;
+	}
+}
+
+EntryCounter::~EntryCounter() {
+	Save();
+}
+
+long long EntryCounter::Entries(const std::string& fileName) {
+	FileIdentity file;
+	if(!file.Stat(fileName)) {
+		return -1;
+	}
+	auto it = fFiles.find(file.fPath);
+	if(it == fFiles.end() || it->second.fFile != file) {
+		return -1;
+	}
+	return it->second.fValue;
+}
+
+void EntryCounter::Count(const std::vector<std::string>& fileNames, int threads) {
+	std::vector<std::string> unknown;
+	for(const auto& fileName : fileNames) {
+		if(Entries(fileName) < 0) {
+			unknown.push_back(fileName);
+		}
+	}
+	if(unknown.empty()) {
+		return;
+	}
+	if(threads < 1) {
+		threads = 1;
+	}
+	if(fVerbosityLevel > 0) {
+		std::cout<<"counting entries of "<<unknown.size()<<" files using "<<threads<<" threads"<<std::endl;
+	}
+
+	//each thread takes the next file from the list until all files are done
+	ROOT::EnableThreadSafety();
+	std::vector<long long> entries(unknown.size(), -1);
+	std::atomic<size_t> next(0);
+	auto count = [&]() {
+		for(size_t i = next++; i < unknown.size(); i = next++) {
+			TFile* file = TFile::Open(unknown[i].c_str());
+			if(file == nullptr) {
+				continue;
+			}
+			if(file->IsOpen()) {
+				TTree* tree = file->Get<TTree>(fTreeName.c_str());
+				if(tree != nullptr) {
+					entries[i] = tree->GetEntries();
+				}
+				file->Close();
+			}
+			delete file;
+		}
+	};
+	std::vector<std::thread> pool;
+	for(int t = 0; t < threads && t < static_cast<int>(unknown.size()); ++t) {
+		pool.emplace_back(count);
+	}
+	for(auto& thread : pool) {
+		thread.join();
+	}
+
+	for(size_t i = 0; i < unknown.size(); ++i) {
+		FileList::Entry entry;
+		if(entries[i] < 0 || !entry.fFile.Stat(unknown[i])) {
+			std::cerr<<"Failed to get number of entries of '"<<unknown[i]<<"'"<<std::endl;
+			continue;
+		}
+		entry.fValue = entries[i];
+		fFiles[entry.fFile.fPath] = entry;
+		fCounted.insert(entry.fFile.fPath);
+	}
+}
+
+bool EntryCounter::Save() {
+	if(fSidecarFileName.empty() || fCounted.empty()) {
+		return true;
+	}
+	//other jobs might have counted other files since we read the sidecar file, so we only add our own counts to the current file
+	std::map<std::string, FileList::Entry> files;
+	FileList::Read(fSidecarFileName, files);
+	for(const auto& path : fCounted) {
+		files[path] = fFiles[path];
+	}
+	if(!FileList::Write(fSidecarFileName, files)) {
+		return false;
+	}
+	fCounted.clear();
+	return true;
+}
@@ -0,0 +1,35 @@
+#ifndef __ENTRYCOUNTER_HH
+#define __ENTRYCOUNTER_HH
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "FileList.hh"
+
+// number of entries of the ntuple in each input file
+// the numbers are stored in a sidecar file together with the size and modification time of each input file,
+// so they only have to be counted again if a file changed, counting is done in parallel
+class EntryCounter {
+public:
+	EntryCounter(const std::string& sidecarFileName, const std::string& treeName, int verbosityLevel);
+	~EntryCounter();
+
+	// returns -1 if the number of entries of this file is unknown (or the file changed)
+	long long Entries(const std::string& fileName);
+	// opens all files with an unknown number of entries and counts them
+	void Count(const std::vector<std::string>& fileNames, int threads);
+	// merges the newly counted files into the current sidecar file (which other jobs might have updated meanwhile)
+	// nothing is written if no file has been counted
+	bool Save();
+
+private:
+	std::string fSidecarFileName;
+	std::string fTreeName;
+	int fVerbosityLevel;
+	std::map<std::string, FileList::Entry> fFiles;
+	// files counted by this job, only these are written to the sidecar file
+	std::set<std::string> fCounted;
+};
+#endif
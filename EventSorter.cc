@@ -0,0 +1,121 @@
+#include "EventSorter.hh"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <stdlib.h>
+
+EventSorter::EventSorter(size_t maxHitsInMemory, const std::string& directory, int verbosityLevel)
+	: fMaxHitsInMemory(maxHitsInMemory), fDirectory(directory), fVerbosityLevel(verbosityLevel), fBufferPosition(0)
+{
+	if(fMaxHitsInMemory == 0) {
+		fMaxHitsInMemory = 1;
+	}
+	fBuffer.reserve(fMaxHitsInMemory);
+}
+
+EventSorter::~EventSorter() {
+	Cleanup();
+}
+
+bool EventSorter::Add(const Hit& hit) {
+	fBuffer.push_back(hit);
+	if(fBuffer.size() >= fMaxHitsInMemory) {
+		return Spill();
+	}
+	return true;
+}
+
+bool EventSorter::Spill() {
+	std::stable_sort(fBuffer.begin(), fBuffer.end(), [](const Hit& a, const Hit& b) { return a.fEventNumber < b.fEventNumber; });
+
+	Run run;
+	run.fFileName = fDirectory + "/NTuple2EventTreeSortXXXXXX";
+	std::vector<char> name(run.fFileName.begin(), run.fFileName.end());
+	name.push_back('\0');
+	int fd = mkstemp(name.data());
+	if(fd < 0) {
+		std::cerr<<"Failed to create temporary file in '"<<fDirectory<<"' for sorting: "<<strerror(errno)<<std::endl;
+		return false;
+	}
+	run.fFileName = name.data();
+	run.fFile = fdopen(fd, "w+b");
+	if(run.fFile == nullptr) {
+		close(fd);
+		unlink(run.fFileName.c_str());
+		return false;
+	}
+	// add the run before writing, so that the file is removed even if writing fails
+	fRuns.push_back(run);
+	if(fwrite(fBuffer.data(), sizeof(Hit), fBuffer.size(), run.fFile) != fBuffer.size() || fflush(run.fFile) != 0) {
+		std::cerr<<"Failed to write "<<fBuffer.size()<<" hits to temporary file '"<<run.fFileName<<"': "<<strerror(errno)<<std::endl;
+		return false;
+	}
+	if(fVerbosityLevel > 1) {
+		std::cout<<"wrote sorted run #"<<fRuns.size()<<" with "<<fBuffer.size()<<" hits to "<<run.fFileName<<std::endl;
+	}
+	fBuffer.clear();
+
+	return true;
+}
+
+bool EventSorter::Finish() {
+	std::stable_sort(fBuffer.begin(), fBuffer.end(), [](const Hit& a, const Hit& b) { return a.fEventNumber < b.fEventNumber; });
+	fBufferPosition = 0;
+
+	for(size_t run = 0; run < fRuns.size(); ++run) {
+		rewind(fRuns[run].fFile);
+		if(ReadNext(run)) {
+			fQueue.push(std::make_pair(fRuns[run].fCurrent.fEventNumber, run));
+		}
+	}
+	// the hits still in memory were added last, so they are merged as the last run
+	if(!fBuffer.empty()) {
+		fQueue.push(std::make_pair(fBuffer[0].fEventNumber, fRuns.size()));
+	}
+
+	if(fVerbosityLevel > 0) {
+		std::cout<<"merging "<<fRuns.size()<<" sorted runs from disk and "<<fBuffer.size()<<" hits from memory"<<std::endl;
+	}
+
+	return true;
+}
+
+bool EventSorter::Next(Hit& hit) {
+	if(fQueue.empty()) {
+		return false;
+	}
+	size_t run = fQueue.top().second;
+	fQueue.pop();
+
+	if(run == fRuns.size()) {
+		hit = fBuffer[fBufferPosition++];
+		if(fBufferPosition < fBuffer.size()) {
+			fQueue.push(std::make_pair(fBuffer[fBufferPosition].fEventNumber, run));
+		}
+	} else {
+		hit = fRuns[run].fCurrent;
+		if(ReadNext(run)) {
+			fQueue.push(std::make_pair(fRuns[run].fCurrent.fEventNumber, run));
+		}
+	}
+
+	return true;
+}
+
+bool EventSorter::ReadNext(size_t run) {
+	return fread(&fRuns[run].fCurrent, sizeof(Hit), 1, fRuns[run].fFile) == 1;
+}
+
+void EventSorter::Cleanup() {
+	for(auto& run : fRuns) {
+		if(run.fFile != nullptr) {
+			fclose(run.fFile);
+		}
+		unlink(run.fFileName.c_str());
+	}
+	fRuns.clear();
+}
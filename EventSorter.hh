@@ -0,0 +1,51 @@
+#ifndef __EVENTSORTER_HH
+#define __EVENTSORTER_HH
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <utility>
+#include <functional>
+#include <cstdio>
+
+#include "Hit.hh"
+
+// groups hits by event number for inputs where the hits of one event aren't contiguous
+// hits are collected in memory, and each time the buffer is full it is sorted and written to a temporary file (one sorted run)
+// at the end all runs are merged, hits of the same event keep the order in which they were added
+class EventSorter {
+public:
+	EventSorter(size_t maxHitsInMemory, const std::string& directory, int verbosityLevel);
+	~EventSorter();
+
+	bool Add(const Hit& hit);
+	// sorts the remaining hits and prepares the merge, has to be called once after all hits have been added
+	bool Finish();
+	// returns the next hit in event order, false once all hits have been returned
+	bool Next(Hit& hit);
+
+	size_t NumberOfRuns() { return fRuns.size(); }
+	size_t BufferedHits() { return fBuffer.size() - fBufferPosition; }
+
+private:
+	struct Run {
+		std::string fFileName;
+		FILE* fFile;
+		Hit fCurrent;
+	};
+
+	bool Spill();
+	bool ReadNext(size_t run);
+	void Cleanup();
+
+	size_t fMaxHitsInMemory;
+	std::string fDirectory;
+	int fVerbosityLevel;
+
+	std::vector<Hit> fBuffer;
+	size_t fBufferPosition;
+	std::vector<Run> fRuns;
+	// event number and run index of the next hit of each run, the in-memory buffer has the index fRuns.size()
+	std::priority_queue<std::pair<int, size_t>, std::vector<std::pair<int, size_t> >, std::greater<std::pair<int, size_t> > > fQueue;
+};
+#endif
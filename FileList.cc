@@ -0,0 +1,58 @@
+#include "FileList.hh"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+bool FileIdentity::Stat(const std::string& fileName) {
+	struct stat fileStat;
+	if(stat(fileName.c_str(), &fileStat) != 0) {
+		return false;
+	}
+	char resolved[PATH_MAX];
+	if(realpath(fileName.c_str(), resolved) == nullptr) {
+		return false;
+	}
+	fPath = resolved;
+	fSize = fileStat.st_size;
+	fModified = fileStat.st_mtime;
+	return true;
+}
+
+bool FileList::Read(const std::string& fileName, std::map<std::string, Entry>& entries) {
+	std::ifstream input(fileName.c_str());
+	if(!input.is_open()) {
+		return false;
+	}
+	std::string line;
+	while(std::getline(input, line)) {
+		std::istringstream str(line);
+		Entry entry;
+		if(str>>entry.fValue>>entry.fFile.fSize>>entry.fFile.fModified && std::getline(str>>std::ws, entry.fFile.fPath)) {
+			entries[entry.fFile.fPath] = entry;
+		}
+	}
+	return true;
+}
+
+bool FileList::Write(const std::string& fileName, const std::map<std::string, Entry>& entries) {
+	std::ostringstream tmpFileName;
+	tmpFileName<<fileName<<".tmp"<<getpid();
+	std::ofstream output(tmpFileName.str().c_str());
+	for(const auto& entry : entries) {
+		output<<entry.second.fValue<<" "<<entry.second.fFile.fSize<<" "<<entry.second.fFile.fModified<<" "<<entry.second.fFile.fPath<<std::endl;
+	}
+	output.close();
+	if(!output || std::rename(tmpFileName.str().c_str(), fileName.c_str()) != 0) {
+		std::cerr<<"Failed to write file list '"<<fileName<<"'!"<<std::endl;
+		std::remove(tmpFileName.str().c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,36 @@
+#ifndef __FILELIST_HH
+#define __FILELIST_HH
+
+#include <string>
+#include <map>
+
+// identifies an input file by its real path, size, and modification time
+// a file with the same path, size, and modification time is assumed to be unchanged
+struct FileIdentity {
+	std::string fPath;
+	long long fSize;
+	long long fModified;
+
+	FileIdentity() : fSize(-1), fModified(-1) {}
+	// resolves the path and gets size and modification time, returns false if the file doesn't exist
+	bool Stat(const std::string& fileName);
+
+	bool operator==(const FileIdentity& rhs) const { return fPath == rhs.fPath && fSize == rhs.fSize && fModified == rhs.fModified; }
+	bool operator!=(const FileIdentity& rhs) const { return !(*this == rhs); }
+};
+
+// list of files with one value each (e.g. number of entries or part number), stored as text with one line per file:
+// value, size, modification time, and path
+class FileList {
+public:
+	struct Entry {
+		FileIdentity fFile;
+		long long fValue;
+	};
+
+	// reads the entries (by path) from the list, returns false if the list doesn't exist
+	static bool Read(const std::string& fileName, std::map<std::string, Entry>& entries);
+	// writes to a temporary file and renames it, so other jobs or an interrupted job never leave an incomplete list
+	static bool Write(const std::string& fileName, const std::map<std::string, Entry>& entries);
+};
+#endif
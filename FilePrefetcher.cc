@@ -0,0 +1,80 @@
+#include "FilePrefetcher.hh"
+
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+FilePrefetcher::FilePrefetcher(long long maxBytes, int verbosityLevel)
+	: fMaxBytes(maxBytes), fVerbosityLevel(verbosityLevel), fStop(false)
+{
+	fThread = std::thread(&FilePrefetcher::Loop, this);
+}
+
+FilePrefetcher::~FilePrefetcher() {
+	{
+		std::lock_guard<std::mutex> lock(fMutex);
+		fStop = true;
+		fQueue.clear();
+	}
+	fCondition.notify_one();
+	fThread.join();
+}
+
+void FilePrefetcher::Prefetch(const std::string& fileName) {
+	{
+		std::lock_guard<std::mutex> lock(fMutex);
+		fQueue.push_back(fileName);
+	}
+	fCondition.notify_one();
+}
+
+size_t FilePrefetcher::Pending() {
+	std::lock_guard<std::mutex> lock(fMutex);
+	return fQueue.size();
+}
+
+void FilePrefetcher::Loop() {
+	while(true) {
+		std::string fileName;
+		{
+			std::unique_lock<std::mutex> lock(fMutex);
+			fCondition.wait(lock, [this] { return fStop || !fQueue.empty(); });
+			if(fStop) {
+				return;
+			}
+			fileName = fQueue.front();
+		}
+		Read(fileName);
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			if(!fQueue.empty()) {
+				fQueue.pop_front();
+			}
+		}
+	}
+}
+
+void FilePrefetcher::Read(const std::string& fileName) {
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if(fd < 0) {
+		return;
+	}
+#ifdef POSIX_FADV_WILLNEED
+	posix_fadvise(fd, 0, fMaxBytes, POSIX_FADV_WILLNEED);
+#endif
+	// actually reading the file is necessary for network file systems that ignore the advice
+	std::vector<char> buffer(4*1024*1024);
+	long long total = 0;
+	ssize_t bytes;
+	while(total < fMaxBytes && (bytes = read(fd, buffer.data(), buffer.size())) > 0) {
+		total += bytes;
+		std::lock_guard<std::mutex> lock(fMutex);
+		if(fStop) break;
+	}
+	close(fd);
+	if(fVerbosityLevel > 1) {
+		std::cout<<"prefetched "<<total<<" bytes of "<<fileName<<std::endl;
+	}
+}
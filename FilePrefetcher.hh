@@ -0,0 +1,33 @@
+#ifndef __FILEPREFETCHER_HH
+#define __FILEPREFETCHER_HH
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// reads input files in a background thread so that they are in the page cache once the converter opens them
+// this hides the latency of network-mounted storage, at most maxBytes of each file are read
+class FilePrefetcher {
+public:
+	FilePrefetcher(long long maxBytes, int verbosityLevel);
+	~FilePrefetcher();
+
+	void Prefetch(const std::string& fileName);
+	size_t Pending();
+
+private:
+	void Loop();
+	void Read(const std::string& fileName);
+
+	long long fMaxBytes;
+	int fVerbosityLevel;
+
+	std::deque<std::string> fQueue;
+	std::mutex fMutex;
+	std::condition_variable fCondition;
+	bool fStop;
+	std::thread fThread;
+};
+#endif
@@ -0,0 +1,34 @@
+#ifndef __FRAGMENTRECORD_HH
+#define __FRAGMENTRECORD_HH
+
+#include <iostream>
+
+#include "Rtypes.h"
+
+#include "TFragment.h"
+
+// compact representation of a fragment (the sum of all hits of one channel within an event)
+// this is used while processing the hits, TFragments are only created when the event is written
+struct FragmentRecord {
+	Long64_t fTimeStamp;
+	Long64_t fDaqTimeStamp;
+	UInt_t fAddress;
+	Int_t fCfd;
+	Float_t fCharge;
+	Short_t fKValue;
+
+	void CopyTo(TFragment* fragment) const {
+		fragment->Clear();
+		fragment->SetAddress(fAddress);
+		fragment->SetCfd(fCfd);
+		fragment->SetCharge(fCharge);
+		fragment->SetKValue(fKValue);
+		fragment->SetDaqTimeStamp(fDaqTimeStamp);
+		fragment->SetTimeStamp(fTimeStamp);
+	}
+
+	void Print() const {
+		std::cout<<"address 0x"<<std::hex<<fAddress<<std::dec<<", charge "<<fCharge<<", k-value "<<fKValue<<", cfd "<<fCfd<<", timestamp "<<fTimeStamp<<", daq timestamp "<<fDaqTimeStamp<<std::endl;
+	}
+};
+#endif
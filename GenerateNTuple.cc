@@ -0,0 +1,186 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TRandom3.h"
+
+#include "CommandLineInterface.hh"
+
+#include "Hit.hh"
+
+// creates a synthetic ntuple with the same branches as the Geant4 simulation, e.g. to benchmark the converter
+// number of crystals and detectors for each system ID, so that all addresses created by the converter are valid
+void DetectorRange(int systemID, int& nDetectors, int& nCrystals) {
+	switch(systemID) {
+		case 1000://griffin
+			nDetectors = 16; nCrystals = 4;
+			break;
+		case 1010://suppressors
+		case 1020:
+		case 1030:
+		case 1040:
+		case 1050:
+			nDetectors = 16; nCrystals = 4;
+			break;
+		case 2000://LaBr
+			nDetectors = 8; nCrystals = 1;
+			break;
+		case 5000://SCEPTAR
+			nDetectors = 20; nCrystals = 1;
+			break;
+		case 50://PACES
+			nDetectors = 5; nCrystals = 1;
+			break;
+		case 8010://DESCANT
+		case 8020:
+		case 8030:
+		case 8040:
+		case 8050:
+			nDetectors = 70; nCrystals = 1;
+			break;
+		default:
+			nDetectors = 16; nCrystals = 1;
+			break;
+	}
+}
+
+int main(int argc, char** argv) {
+	//parse all command line options
+	CommandLineInterface interface;
+	std::string outputFileName;
+	interface.Add("-of","output file (required)", &outputFileName);
+	std::string treeName = "ntuple";
+	interface.Add("-tn","name of the tree (default = 'ntuple')", &treeName);
+	int nEvents = 10000;
+	interface.Add("-ne","number of events (default = 10000)", &nEvents);
+	int firstEvent = 0;
+	interface.Add("-fe","event number of the first event (default = 0)", &firstEvent);
+	double hitsPerEvent = 10.;
+	interface.Add("-hpe","mean number of hits per event, poisson distributed with at least one hit (default = 10)", &hitsPerEvent);
+	std::vector<int> systemIDs;
+	interface.Add("-sys","system IDs of the hits (default = 1000 1050 2000 5000)", &systemIDs);
+	std::vector<double> weights;
+	interface.Add("-wt","relative weights of the system IDs (default = 0.6 0.2 0.1 0.1)", &weights);
+	int interleave = 1;
+	interface.Add("-il","number of consecutive events whose hits are shuffled together, 1 = hits sorted by event (default = 1)", &interleave);
+	int seed = 1;
+	interface.Add("-seed","seed of the random number generator (default = 1)", &seed);
+
+	interface.CheckFlags(argc, argv);
+
+	if(outputFileName.empty()) {
+		std::cerr<<"Missing output file name!"<<std::endl;
+		return 1;
+	}
+	if(systemIDs.empty()) {
+		systemIDs = {1000, 1050, 2000, 5000};
+		if(weights.empty()) {
+			weights = {0.6, 0.2, 0.1, 0.1};
+		}
+	}
+	if(weights.empty()) {
+		weights.assign(systemIDs.size(), 1.);
+	}
+	if(weights.size() != systemIDs.size()) {
+		std::cerr<<"Got "<<systemIDs.size()<<" system IDs, but "<<weights.size()<<" weights!"<<std::endl;
+		return 1;
+	}
+	if(interleave < 1) {
+		interleave = 1;
+	}
+
+	//cumulative weights to pick the system of each hit
+	std::vector<double> cumulative(weights.size());
+	double sum = 0.;
+	for(size_t i = 0; i < weights.size(); ++i) {
+		sum += weights[i];
+		cumulative[i] = sum;
+	}
+
+	TFile output(outputFileName.c_str(), "recreate");
+	if(!output.IsOpen()) {
+		std::cerr<<"Failed to open file '"<<outputFileName<<"'!"<<std::endl;
+		return 1;
+	}
+
+	//the tree belongs to the output file (and is deleted when the file is closed)
+	Hit hit;
+	TTree* tree = new TTree(treeName.c_str(), "synthetic hits");
+	tree->Branch("eventNumber", &hit.fEventNumber, "eventNumber/I");
+	tree->Branch("trackID", &hit.fTrackID, "trackID/I");
+	tree->Branch("parentID", &hit.fParentID, "parentID/I");
+	tree->Branch("stepNumber", &hit.fStepNumber, "stepNumber/I");
+	tree->Branch("particleType", &hit.fParticleType, "particleType/I");
+	tree->Branch("processType", &hit.fProcessType, "processType/I");
+	tree->Branch("systemID", &hit.fSystemID, "systemID/I");
+	tree->Branch("cryNumber", &hit.fCryNumber, "cryNumber/I");
+	tree->Branch("detNumber", &hit.fDetNumber, "detNumber/I");
+	tree->Branch("depEnergy", &hit.fDepEnergy, "depEnergy/D");
+	tree->Branch("posx", &hit.fPosx, "posx/D");
+	tree->Branch("posy", &hit.fPosy, "posy/D");
+	tree->Branch("posz", &hit.fPosz, "posz/D");
+	tree->Branch("time", &hit.fTime, "time/D");
+
+	TRandom3 random(seed);
+	std::vector<Hit> hits;
+	long int nHits = 0;
+	for(int group = 0; group < nEvents; group += interleave) {
+		hits.clear();
+		for(int event = group; event < std::min(group + interleave, nEvents); ++event) {
+			int n = std::max(1, random.Poisson(hitsPerEvent));
+			for(int i = 0; i < n; ++i) {
+				Hit newHit = Hit();
+				newHit.fEventNumber = firstEvent + event;
+				newHit.fTrackID = i + 1;
+				newHit.fParentID = i;
+				newHit.fStepNumber = 1;
+				newHit.fParticleType = 1;
+				newHit.fProcessType = 1;
+				double pick = random.Uniform(0., sum);
+				size_t system = std::lower_bound(cumulative.begin(), cumulative.end(), pick) - cumulative.begin();
+				if(system >= systemIDs.size()) system = systemIDs.size() - 1;
+				newHit.fSystemID = systemIDs[system];
+				int nDetectors;
+				int nCrystals;
+				DetectorRange(newHit.fSystemID, nDetectors, nCrystals);
+				newHit.fDetNumber = random.Integer(nDetectors);
+				newHit.fCryNumber = random.Integer(nCrystals);
+				//half of the hits in a few gamma lines, the rest a flat background (in keV)
+				if(random.Rndm() < 0.5) {
+					const double lines[] = {121.8, 344.3, 661.7, 1173.2, 1332.5};
+					newHit.fDepEnergy = lines[random.Integer(5)];
+				} else {
+					newHit.fDepEnergy = random.Uniform(10., 3000.);
+				}
+				newHit.fPosx = random.Uniform(-100., 100.);
+				newHit.fPosy = random.Uniform(-100., 100.);
+				newHit.fPosz = random.Uniform(-100., 100.);
+				//time since the start of the event in seconds
+				newHit.fTime = random.Exp(50e-9);
+				hits.push_back(newHit);
+			}
+		}
+		//shuffle the hits of all events in this group to emulate hits written by several threads
+		if(interleave > 1) {
+			for(size_t i = hits.size(); i > 1; --i) {
+				std::swap(hits[i-1], hits[random.Integer(i)]);
+			}
+		}
+		for(const auto& groupHit : hits) {
+			hit = groupHit;
+			tree->Fill();
+			++nHits;
+		}
+	}
+
+	output.cd();
+	tree->Write();
+	output.Close();
+
+	std::cout<<"wrote "<<nHits<<" hits of "<<nEvents<<" events to "<<outputFileName<<std::endl;
+
+	return 0;
+}
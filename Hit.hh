@@ -0,0 +1,23 @@
+#ifndef __HIT_HH
+#define __HIT_HH
+
+#include "Rtypes.h"
+
+// one entry (step) of the Geant4 ntuple, the members are the branches of the ntuple
+struct Hit {
+	Int_t fEventNumber;
+	Int_t fTrackID;
+	Int_t fParentID;
+	Int_t fStepNumber;
+	Int_t fParticleType;
+	Int_t fProcessType;
+	Int_t fSystemID;
+	Int_t fCryNumber;
+	Int_t fDetNumber;
+	Double_t fDepEnergy;
+	Double_t fPosx;
+	Double_t fPosy;
+	Double_t fPosz;
+	Double_t fTime;
+};
+#endif
@@ -0,0 +1,240 @@
+#include "HitCache.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+	const char kMagic[8] = {'N', '2', 'E', 'T', 'H', 'I', 'T', 'S'};
+	const uint32_t kVersion = 2;
+
+	// all columns start at a 64 byte boundary (one cache line)
+	uint64_t Align(uint64_t offset) {
+		return (offset + 63) & ~static_cast<uint64_t>(63);
+	}
+
+	bool WriteAt(int fd, const void* data, size_t size, uint64_t offset) {
+		const char* pos = static_cast<const char*>(data);
+		while(size > 0) {
+			ssize_t written = pwrite(fd, pos, size, offset);
+			if(written < 0) {
+				if(errno == EINTR) continue;
+				return false;
+			}
+			pos += written;
+			size -= written;
+			offset += written;
+		}
+		return true;
+	}
+
+	// buffered writer for a single column, the column is written sequentially starting at its offset
+	template<typename T>
+	class ColumnWriter {
+	public:
+		ColumnWriter(int fd, uint64_t offset) : fFd(fd), fOffset(offset), fGood(true) { fBuffer.reserve(kBufferSize); }
+
+		void Add(T value) {
+			fBuffer.push_back(value);
+			if(fBuffer.size() == kBufferSize) Flush();
+		}
+		void Flush() {
+			if(fBuffer.empty()) return;
+			fGood = WriteAt(fFd, fBuffer.data(), fBuffer.size()*sizeof(T), fOffset) && fGood;
+			fOffset += fBuffer.size()*sizeof(T);
+			fBuffer.clear();
+		}
+		bool Good() { return fGood; }
+
+	private:
+		static const size_t kBufferSize = 65536;
+		int fFd;
+		uint64_t fOffset;
+		bool fGood;
+		std::vector<T> fBuffer;
+	};
+}
+
+HitCache::HitCache()
+	: fMap(nullptr), fSize(0), fHeader(nullptr), fEnergy(nullptr), fTime(nullptr), fSystemID(nullptr), fDetNumber(nullptr), fCryNumber(nullptr), fEventNumber(nullptr), fEventOffset(nullptr)
+{
+}
+
+HitCache::~HitCache() {
+	Close();
+}
+
+bool HitCache::Write(long int nEntries, const std::function<bool(Hit&)>& next, const std::vector<FileIdentity>& inputFiles, const std::string& fileName, int verbosityLevel) {
+	Hit hit;
+
+	// the number of hits is known, so the hit columns can be placed right away, the event table goes at the end
+	HitCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.fMagic, kMagic, sizeof(kMagic));
+	header.fVersion = kVersion;
+	header.fNumberOfHits = nEntries;
+	header.fEnergyOffset = Align(sizeof(HitCacheHeader));
+	header.fTimeOffset = Align(header.fEnergyOffset + nEntries*sizeof(float));
+	header.fSystemOffset = Align(header.fTimeOffset + nEntries*sizeof(float));
+	header.fDetectorOffset = Align(header.fSystemOffset + nEntries*sizeof(uint16_t));
+	header.fCrystalOffset = Align(header.fDetectorOffset + nEntries*sizeof(uint8_t));
+	header.fEventNumberOffset = Align(header.fCrystalOffset + nEntries*sizeof(uint8_t));
+
+	int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		std::cerr<<"Failed to open hit cache file '"<<fileName<<"': "<<strerror(errno)<<std::endl;
+		return false;
+	}
+
+	ColumnWriter<float> energy(fd, header.fEnergyOffset);
+	ColumnWriter<float> time(fd, header.fTimeOffset);
+	ColumnWriter<uint16_t> systemID(fd, header.fSystemOffset);
+	ColumnWriter<uint8_t> detNumber(fd, header.fDetectorOffset);
+	ColumnWriter<uint8_t> cryNumber(fd, header.fCrystalOffset);
+	std::vector<int32_t> eventNumbers;
+	std::vector<uint64_t> eventOffsets;
+
+	bool success = true;
+	for(long int i = 0; i < nEntries; ++i) {
+		if(!next(hit)) {
+			std::cerr<<"Error occured, couldn't read hit "<<i<<", can't create hit cache"<<std::endl;
+			success = false;
+			break;
+		}
+		if(hit.fSystemID < 0 || hit.fSystemID > UINT16_MAX || hit.fDetNumber < 0 || hit.fDetNumber > UINT8_MAX || hit.fCryNumber < 0 || hit.fCryNumber > UINT8_MAX) {
+			std::cerr<<"Error, entry "<<i<<" has system ID "<<hit.fSystemID<<", detector "<<hit.fDetNumber<<", and crystal "<<hit.fCryNumber<<" which don't fit into the hit cache"<<std::endl;
+			success = false;
+			break;
+		}
+		// start a new event whenever the event number changes (same as the converter does)
+		if(eventNumbers.empty() || hit.fEventNumber != eventNumbers.back()) {
+			eventNumbers.push_back(hit.fEventNumber);
+			eventOffsets.push_back(i);
+		}
+		energy.Add(hit.fDepEnergy);
+		time.Add(hit.fTime);
+		systemID.Add(hit.fSystemID);
+		detNumber.Add(hit.fDetNumber);
+		cryNumber.Add(hit.fCryNumber);
+
+		if(i%1000 == 0 && verbosityLevel > 0) {
+			std::cout<<std::setw(3)<<100*i/nEntries<<"% done\r"<<std::flush;
+		}
+	}
+	eventOffsets.push_back(nEntries);
+
+	energy.Flush();
+	time.Flush();
+	systemID.Flush();
+	detNumber.Flush();
+	cryNumber.Flush();
+	success = success && energy.Good() && time.Good() && systemID.Good() && detNumber.Good() && cryNumber.Good();
+
+	header.fNumberOfEvents = eventNumbers.size();
+	header.fEventOffsetOffset = Align(header.fEventNumberOffset + eventNumbers.size()*sizeof(int32_t));
+	success = success && WriteAt(fd, eventNumbers.data(), eventNumbers.size()*sizeof(int32_t), header.fEventNumberOffset);
+	success = success && WriteAt(fd, eventOffsets.data(), eventOffsets.size()*sizeof(uint64_t), header.fEventOffsetOffset);
+	std::ostringstream input;
+	for(const auto& file : inputFiles) {
+		input<<file.fSize<<" "<<file.fModified<<" "<<file.fPath<<"\n";
+	}
+	header.fInputOffset = Align(header.fEventOffsetOffset + eventOffsets.size()*sizeof(uint64_t));
+	header.fInputSize = input.str().size();
+	success = success && WriteAt(fd, input.str().data(), header.fInputSize, header.fInputOffset);
+	// the header is written last, so an incomplete file is never mistaken for a valid cache
+	success = success && WriteAt(fd, &header, sizeof(header), 0);
+
+	if(close(fd) != 0) {
+		success = false;
+	}
+	if(!success) {
+		std::cerr<<"Failed to write hit cache file '"<<fileName<<"', removing it!"<<std::endl;
+		unlink(fileName.c_str());
+		return false;
+	}
+
+	std::cout<<"wrote "<<header.fNumberOfHits<<" hits of "<<header.fNumberOfEvents<<" events to hit cache "<<fileName<<std::endl;
+
+	return true;
+}
+
+bool HitCache::Open(const std::string& fileName) {
+	Close();
+
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if(fd < 0) {
+		return false;
+	}
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) != 0 || fileStat.st_size < static_cast<off_t>(sizeof(HitCacheHeader))) {
+		close(fd);
+		return false;
+	}
+	fSize = fileStat.st_size;
+	fMap = mmap(nullptr, fSize, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(fMap == MAP_FAILED) {
+		fMap = nullptr;
+		return false;
+	}
+	madvise(fMap, fSize, MADV_SEQUENTIAL);
+
+	const char* base = static_cast<const char*>(fMap);
+	fHeader = reinterpret_cast<const HitCacheHeader*>(base);
+	if(memcmp(fHeader->fMagic, kMagic, sizeof(kMagic)) != 0 || fHeader->fVersion != kVersion ||
+	   fHeader->fEventOffsetOffset + (fHeader->fNumberOfEvents+1)*sizeof(uint64_t) > fSize ||
+	   fHeader->fInputOffset + fHeader->fInputSize > fSize) {
+		std::cerr<<"File '"<<fileName<<"' is not a valid hit cache (version "<<kVersion<<"), ignoring it!"<<std::endl;
+		Close();
+		return false;
+	}
+
+	fEnergy = reinterpret_cast<const float*>(base + fHeader->fEnergyOffset);
+	fTime = reinterpret_cast<const float*>(base + fHeader->fTimeOffset);
+	fSystemID = reinterpret_cast<const uint16_t*>(base + fHeader->fSystemOffset);
+	fDetNumber = reinterpret_cast<const uint8_t*>(base + fHeader->fDetectorOffset);
+	fCryNumber = reinterpret_cast<const uint8_t*>(base + fHeader->fCrystalOffset);
+	fEventNumber = reinterpret_cast<const int32_t*>(base + fHeader->fEventNumberOffset);
+	fEventOffset = reinterpret_cast<const uint64_t*>(base + fHeader->fEventOffsetOffset);
+
+	std::istringstream input(std::string(base + fHeader->fInputOffset, fHeader->fInputSize));
+	std::string line;
+	while(std::getline(input, line)) {
+		std::istringstream str(line);
+		FileIdentity file;
+		if(str>>file.fSize>>file.fModified && std::getline(str>>std::ws, file.fPath)) {
+			fInputFiles.push_back(file);
+		}
+	}
+
+	return true;
+}
+
+bool HitCache::SameInput(const std::vector<std::string>& fileNames) {
+	std::vector<FileIdentity> files;
+	for(const auto& fileName : fileNames) {
+		FileIdentity file;
+		if(file.Stat(fileName)) {
+			files.push_back(file);
+		}
+	}
+	return files == fInputFiles;
+}
+
+void HitCache::Close() {
+	if(fMap != nullptr) {
+		munmap(fMap, fSize);
+	}
+	fMap = nullptr;
+	fSize = 0;
+	fHeader = nullptr;
+	fInputFiles.clear();
+}
@@ -0,0 +1,76 @@
+#ifndef __HITCACHE_HH
+#define __HITCACHE_HH
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+#include "Hit.hh"
+#include "FileList.hh"
+
+// header of the hit cache file, all offsets are in bytes from the beginning of the file
+struct HitCacheHeader {
+	char fMagic[8];
+	uint32_t fVersion;
+	uint32_t fReserved;
+	uint64_t fNumberOfHits;
+	uint64_t fNumberOfEvents;
+	uint64_t fEnergyOffset;      // float, deposited energy in keV
+	uint64_t fTimeOffset;        // float, time in seconds
+	uint64_t fSystemOffset;      // uint16_t, system ID
+	uint64_t fDetectorOffset;    // uint8_t, detector number
+	uint64_t fCrystalOffset;     // uint8_t, crystal number
+	uint64_t fEventNumberOffset; // int32_t, event number of each event
+	uint64_t fEventOffsetOffset; // uint64_t, index of the first hit of each event (plus one entry for the end of the last event)
+	uint64_t fInputOffset;       // text, one line per input file the cache was built from: size, modification time, and path
+	uint64_t fInputSize;         // size of the input file list in bytes
+};
+
+// compact columnar copy of the ntuple that only contains the branches needed by the converter
+// the hits are grouped by event, and the file is read via mmap without copying the data
+class HitCache {
+public:
+	HitCache();
+	~HitCache();
+
+	// writes nHits hits, which have to be grouped by event, next is called for each hit and returns false if it can't be read
+	static bool Write(long int nHits, const std::function<bool(Hit&)>& next, const std::vector<FileIdentity>& inputFiles, const std::string& fileName, int verbosityLevel);
+
+	bool Open(const std::string& fileName);
+	// true if the cache was built from these input files (ignoring files that don't exist), and none of them changed since
+	bool SameInput(const std::vector<std::string>& fileNames);
+	void Close();
+	bool IsOpen() { return fMap != nullptr; }
+
+	uint64_t NumberOfHits() { return fHeader->fNumberOfHits; }
+	uint64_t NumberOfEvents() { return fHeader->fNumberOfEvents; }
+
+	int EventNumber(uint64_t event) { return fEventNumber[event]; }
+	uint64_t FirstHit(uint64_t event) { return fEventOffset[event]; }
+	uint64_t LastHit(uint64_t event) { return fEventOffset[event+1]; }
+
+	void GetHit(uint64_t index, Hit& hit) {
+		hit.fDepEnergy = fEnergy[index];
+		hit.fTime = fTime[index];
+		hit.fSystemID = fSystemID[index];
+		hit.fDetNumber = fDetNumber[index];
+		hit.fCryNumber = fCryNumber[index];
+	}
+
+private:
+	void* fMap;
+	size_t fSize;
+
+	const HitCacheHeader* fHeader;
+	const float* fEnergy;
+	const float* fTime;
+	const uint16_t* fSystemID;
+	const uint8_t* fDetNumber;
+	const uint8_t* fCryNumber;
+	const int32_t* fEventNumber;
+	const uint64_t* fEventOffset;
+	std::vector<FileIdentity> fInputFiles;
+};
+#endif
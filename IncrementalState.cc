@@ -0,0 +1,190 @@
+#include "IncrementalState.hh"
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "TFileMerger.h"
+
+IncrementalState::IncrementalState(const std::string& directory, int verbosityLevel)
+	: fDirectory(directory), fVerbosityLevel(verbosityLevel), fNextPart(0)
+{
+	if(mkdir(fDirectory.c_str(), 0755) != 0 && errno != EEXIST) {
+		std::cerr<<"Failed to create directory '"<<fDirectory<<"': "<<strerror(errno)<<std::endl;
+	}
+	fStateFileName = fDirectory + "/converted.txt";
+
+	//each line has the part number, size, modification time, and path of one converted file
+	FileList::Read(fStateFileName, fFiles);
+	for(const auto& file : fFiles) {
+		if(file.second.fValue >= fNextPart) {
+			fNextPart = file.second.fValue + 1;
+		}
+	}
+	if(fVerbosityLevel > 0) {
+		std::cout<<"read "<<fFiles.size()<<" converted files from "<<fStateFileName<<std::endl;
+	}
+}
+
+IncrementalState::~IncrementalState() {
+}
+
+std::string IncrementalState::PartName(int part) {
+	char name[16];
+	snprintf(name, sizeof(name), "part%05d", part);
+	return fDirectory + "/" + name;
+}
+
+bool IncrementalState::UpToDate(const std::string& fileName) {
+	FileIdentity file;
+	if(!file.Stat(fileName)) {
+		return false;
+	}
+	auto it = fFiles.find(file.fPath);
+	return it != fFiles.end() && fConverting.count(file.fPath) == 0 && it->second.fFile == file;
+}
+
+std::string IncrementalState::PartDirectory(const std::string& fileName) {
+	FileList::Entry entry;
+	if(!entry.fFile.Stat(fileName)) {
+		std::cerr<<"Failed to get size and modification time of '"<<fileName<<"'!"<<std::endl;
+		return "";
+	}
+	//a changed file keeps its part, but is marked as not converted until it has been converted again
+	auto it = fFiles.find(entry.fFile.fPath);
+	if(it == fFiles.end()) {
+		entry.fValue = fNextPart++;
+		it = fFiles.insert(std::make_pair(entry.fFile.fPath, entry)).first;
+	} else {
+		it->second.fFile = entry.fFile;
+	}
+	fConverting.insert(entry.fFile.fPath);
+	if(!Save()) {
+		return "";
+	}
+
+	std::string directory = PartName(it->second.fValue);
+	if(mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+		std::cerr<<"Failed to create directory '"<<directory<<"': "<<strerror(errno)<<std::endl;
+		return "";
+	}
+	//remove old output, the new conversion might create fewer sub-runs
+	std::vector<std::string> files;
+	if(!ListFiles(directory, files)) {
+		return "";
+	}
+	for(const auto& file : files) {
+		unlink((directory + "/" + file).c_str());
+	}
+
+	return directory;
+}
+
+bool IncrementalState::Done(const std::string& fileName) {
+	FileIdentity file;
+	if(!file.Stat(fileName) || fFiles.count(file.fPath) == 0) {
+		return false;
+	}
+	//keep the size and modification time from before the conversion, so a file that changed meanwhile is converted again
+	fConverting.erase(file.fPath);
+	return Save();
+}
+
+bool IncrementalState::Save() {
+	//only files that have been converted completely are written to the state file
+	std::map<std::string, FileList::Entry> converted;
+	for(const auto& file : fFiles) {
+		if(fConverting.count(file.first) == 0) {
+			converted.insert(file);
+		}
+	}
+	return FileList::Write(fStateFileName, converted);
+}
+
+bool IncrementalState::ListFiles(const std::string& directory, std::vector<std::string>& files) {
+	//files directly in the directory and in its sub-directories (one per settings file if there are several), relative to the directory
+	DIR* dir = opendir(directory.c_str());
+	if(dir == nullptr) {
+		std::cerr<<"Failed to open directory '"<<directory<<"': "<<strerror(errno)<<std::endl;
+		return false;
+	}
+	while(struct dirent* entry = readdir(dir)) {
+		std::string name = entry->d_name;
+		if(name[0] == '.') continue;
+		struct stat fileStat;
+		if(stat((directory + "/" + name).c_str(), &fileStat) != 0) continue;
+		if(S_ISDIR(fileStat.st_mode)) {
+			DIR* subDir = opendir((directory + "/" + name).c_str());
+			if(subDir == nullptr) continue;
+			while(struct dirent* subEntry = readdir(subDir)) {
+				if(subEntry->d_name[0] != '.') {
+					files.push_back(name + "/" + subEntry->d_name);
+				}
+			}
+			closedir(subDir);
+		} else {
+			files.push_back(name);
+		}
+	}
+	closedir(dir);
+	return true;
+}
+
+bool IncrementalState::Merge(const std::vector<std::string>& fileNames) {
+	//collect the output files of all parts, files with the same name are merged
+	//parts of files that aren't part of the input anymore are kept, but not merged
+	std::map<std::string, std::vector<std::string> > outputFiles;
+	for(const auto& fileName : fileNames) {
+		FileIdentity file;
+		if(!file.Stat(fileName) || fFiles.count(file.fPath) == 0 || fConverting.count(file.fPath) != 0) {
+			std::cerr<<"File '"<<fileName<<"' hasn't been converted, can't merge outputs!"<<std::endl;
+			return false;
+		}
+		std::string directory = PartName(fFiles[file.fPath].fValue);
+		std::vector<std::string> files;
+		if(!ListFiles(directory, files)) {
+			return false;
+		}
+		for(const auto& name : files) {
+			if(name.size() > 5 && name.compare(name.size()-5, 5, ".root") == 0) {
+				outputFiles[name].push_back(directory + "/" + name);
+			}
+		}
+	}
+
+	for(const auto& output : outputFiles) {
+		if(fVerbosityLevel > 0) {
+			std::cout<<"merging "<<output.second.size()<<" parts into "<<output.first<<std::endl;
+		}
+		TFileMerger merger(false);
+		merger.OutputFile(output.first.c_str(), true);
+		for(const auto& part : output.second) {
+			merger.AddFile(part.c_str());
+		}
+		if(!merger.Merge()) {
+			std::cerr<<"Failed to merge parts into '"<<output.first<<"'!"<<std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+ULong64_t IncrementalState::Seed(const std::string& fileName, size_t configuration) {
+	//FNV-1a hash of the file name (without directory), so the seed stays the same if the production is moved
+	std::string name = fileName.substr(fileName.find_last_of('/') + 1);
+	ULong64_t hash = 14695981039346656037ULL;
+	for(char c : name) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ULL;
+	}
+	hash ^= configuration + 1;
+	hash *= 1099511628211ULL;
+	//a seed of zero makes TRandom3 choose a seed based on the time
+	return hash == 0 ? 1 : hash;
+}
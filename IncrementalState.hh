@@ -0,0 +1,45 @@
+#ifndef __INCREMENTALSTATE_HH
+#define __INCREMENTALSTATE_HH
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "Rtypes.h"
+
+#include "FileList.hh"
+
+// keeps track of which input files have already been converted for incremental conversion
+// each input file is converted on its own into a part directory, the state file records path, size, and modification time
+// of each converted file, so on a re-run only new or changed files are converted before all parts are merged again
+class IncrementalState {
+public:
+	IncrementalState(const std::string& directory, int verbosityLevel);
+	~IncrementalState();
+
+	// true if this file has been converted and didn't change since
+	bool UpToDate(const std::string& fileName);
+	// returns the (emptied) part directory for this file, or an empty string on failure
+	std::string PartDirectory(const std::string& fileName);
+	// marks this file as converted and saves the state
+	bool Done(const std::string& fileName);
+	// merges the output files from the parts of these input files into the current directory
+	bool Merge(const std::vector<std::string>& fileNames);
+
+	// seed for the random number generator of a configuration, depending only on the file (and not on the other input files)
+	static ULong64_t Seed(const std::string& fileName, size_t configuration);
+
+private:
+	std::string PartName(int part);
+	bool ListFiles(const std::string& directory, std::vector<std::string>& files);
+	bool Save();
+
+	std::string fDirectory;
+	std::string fStateFileName;
+	int fVerbosityLevel;
+	int fNextPart;
+	std::map<std::string, FileList::Entry> fFiles; // the value of each entry is the part number
+	std::set<std::string> fConverting; // files whose conversion hasn't finished yet
+};
+#endif
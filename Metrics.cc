@@ -0,0 +1,153 @@
+#include "Metrics.hh"
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+
+#include "TFile.h"
+
+namespace {
+	// backslash, double quote, and newline have to be escaped in JSON strings and Prometheus label values (same escapes for both)
+	std::string Escape(const std::string& value) {
+		std::string escaped;
+		escaped.reserve(value.size());
+		for(char c : value) {
+			if(c == '\\' || c == '"') {
+				escaped.push_back('\\');
+				escaped.push_back(c);
+			} else if(c == '\n') {
+				escaped.append("\\n");
+			} else {
+				escaped.push_back(c);
+			}
+		}
+		return escaped;
+	}
+}
+
+Metrics::Metrics(const std::string& fileName, int interval)
+	: fFileName(fileName), fInterval(interval), fJob(1), fJobs(1), fTotalEntries(0), fEntries(0), fEvents(0)
+{
+	fJson = (fFileName.size() > 5 && fFileName.compare(fFileName.size()-5, 5, ".json") == 0);
+	fStart = std::chrono::steady_clock::now();
+	fLastUpdate = fStart;
+	Write(false);
+}
+
+void Metrics::StartJob(int job, int jobs) {
+	fJob = job;
+	fJobs = jobs;
+	fStart = std::chrono::steady_clock::now();
+	fLastUpdate = fStart;
+	fTotalEntries = 0;
+	fEntries = 0;
+	fEvents = 0;
+	fInputFile.clear();
+	fQueueDepth.clear();
+	Write(false);
+}
+
+void Metrics::Update(long int entries, long int events) {
+	auto now = std::chrono::steady_clock::now();
+	if(now - fLastUpdate < fInterval) {
+		return;
+	}
+	fLastUpdate = now;
+	fEntries = entries;
+	fEvents = events;
+	Write(false);
+}
+
+void Metrics::Finish(long int events) {
+	fLastUpdate = std::chrono::steady_clock::now();
+	fEntries = fTotalEntries;
+	fEvents = events;
+	Write(fJob >= fJobs);
+}
+
+bool Metrics::Write(bool finished) {
+	double elapsed = std::chrono::duration<double>(fLastUpdate - fStart).count();
+	double hitsPerSecond = 0.;
+	double eventsPerSecond = 0.;
+	double eta = -1.;
+	if(elapsed > 0.) {
+		hitsPerSecond = fEntries/elapsed;
+		eventsPerSecond = fEvents/elapsed;
+	}
+	if(finished) {
+		eta = 0.;
+	} else if(hitsPerSecond > 0. && fTotalEntries > 0) {
+		eta = (fTotalEntries - fEntries)/hitsPerSecond;
+	}
+	long long bytesRead = TFile::GetFileBytesRead();
+	long long bytesWritten = TFile::GetFileBytesWritten();
+
+	std::string tmpFileName = fFileName + ".tmp";
+	std::ofstream output(tmpFileName.c_str());
+	if(!output.is_open()) {
+		std::cerr<<"Failed to open metrics file '"<<tmpFileName<<"'!"<<std::endl;
+		return false;
+	}
+
+	if(fJson) {
+		output<<"{"<<std::endl
+		      <<"  \"job\": "<<fJob<<","<<std::endl
+		      <<"  \"jobs\": "<<fJobs<<","<<std::endl
+		      <<"  \"entries\": "<<fEntries<<","<<std::endl
+		      <<"  \"total_entries\": "<<fTotalEntries<<","<<std::endl
+		      <<"  \"events\": "<<fEvents<<","<<std::endl
+		      <<"  \"elapsed_seconds\": "<<elapsed<<","<<std::endl
+		      <<"  \"hits_per_second\": "<<hitsPerSecond<<","<<std::endl
+		      <<"  \"events_per_second\": "<<eventsPerSecond<<","<<std::endl
+		      <<"  \"bytes_read\": "<<bytesRead<<","<<std::endl
+		      <<"  \"bytes_written\": "<<bytesWritten<<","<<std::endl
+		      <<"  \"eta_seconds\": "<<eta<<","<<std::endl
+		      <<"  \"input_file\": \""<<Escape(fInputFile)<<"\","<<std::endl
+		      <<"  \"queues\": {";
+		for(auto queue = fQueueDepth.begin(); queue != fQueueDepth.end(); ++queue) {
+			output<<(queue == fQueueDepth.begin() ? "" : ",")<<" \""<<queue->first<<"\": "<<queue->second;
+		}
+		output<<" },"<<std::endl
+		      <<"  \"finished\": "<<(finished ? "true" : "false")<<std::endl
+		      <<"}"<<std::endl;
+	} else {
+		output<<"# TYPE ntuple2eventtree_job gauge"<<std::endl
+		      <<"ntuple2eventtree_job "<<fJob<<std::endl
+		      <<"# TYPE ntuple2eventtree_jobs gauge"<<std::endl
+		      <<"ntuple2eventtree_jobs "<<fJobs<<std::endl
+		      <<"# TYPE ntuple2eventtree_entries_processed counter"<<std::endl
+		      <<"ntuple2eventtree_entries_processed "<<fEntries<<std::endl
+		      <<"# TYPE ntuple2eventtree_entries_total gauge"<<std::endl
+		      <<"ntuple2eventtree_entries_total "<<fTotalEntries<<std::endl
+		      <<"# TYPE ntuple2eventtree_events_processed counter"<<std::endl
+		      <<"ntuple2eventtree_events_processed "<<fEvents<<std::endl
+		      <<"# TYPE ntuple2eventtree_elapsed_seconds gauge"<<std::endl
+		      <<"ntuple2eventtree_elapsed_seconds "<<elapsed<<std::endl
+		      <<"# TYPE ntuple2eventtree_hits_per_second gauge"<<std::endl
+		      <<"ntuple2eventtree_hits_per_second "<<hitsPerSecond<<std::endl
+		      <<"# TYPE ntuple2eventtree_events_per_second gauge"<<std::endl
+		      <<"ntuple2eventtree_events_per_second "<<eventsPerSecond<<std::endl
+		      <<"# TYPE ntuple2eventtree_bytes_read counter"<<std::endl
+		      <<"ntuple2eventtree_bytes_read "<<bytesRead<<std::endl
+		      <<"# TYPE ntuple2eventtree_bytes_written counter"<<std::endl
+		      <<"ntuple2eventtree_bytes_written "<<bytesWritten<<std::endl
+		      <<"# TYPE ntuple2eventtree_eta_seconds gauge"<<std::endl
+		      <<"ntuple2eventtree_eta_seconds "<<eta<<std::endl
+		      <<"# TYPE ntuple2eventtree_input_file_info gauge"<<std::endl
+		      <<"ntuple2eventtree_input_file_info{file=\""<<Escape(fInputFile)<<"\"} 1"<<std::endl
+		      <<"# TYPE ntuple2eventtree_queue_depth gauge"<<std::endl;
+		for(auto queue : fQueueDepth) {
+			output<<"ntuple2eventtree_queue_depth{queue=\""<<queue.first<<"\"} "<<queue.second<<std::endl;
+		}
+		output<<"# TYPE ntuple2eventtree_finished gauge"<<std::endl
+		      <<"ntuple2eventtree_finished "<<(finished ? 1 : 0)<<std::endl;
+	}
+	output.close();
+
+	if(std::rename(tmpFileName.c_str(), fFileName.c_str()) != 0) {
+		std::cerr<<"Failed to rename metrics file '"<<tmpFileName<<"' to '"<<fFileName<<"'!"<<std::endl;
+		return false;
+	}
+
+	return true;
+}
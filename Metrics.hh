@@ -0,0 +1,44 @@
+#ifndef __METRICS_HH
+#define __METRICS_HH
+
+#include <string>
+#include <map>
+#include <chrono>
+
+// writes the progress and throughput of the conversion to a file, which is refreshed periodically
+// the file is written in JSON format if the name ends in ".json", otherwise in the Prometheus text format
+// the file is replaced atomically (written to a temporary file, then renamed), so it can be read at any time
+class Metrics {
+public:
+	Metrics(const std::string& fileName, int interval);
+	~Metrics(){};
+
+	// resets the counters and the start time for the next of several jobs (one-based), only the last job marks the metrics as finished
+	void StartJob(int job, int jobs);
+	void SetTotalEntries(long int entries) { fTotalEntries = entries; }
+	void SetInputFile(const std::string& fileName) { fInputFile = fileName; }
+	void SetQueueDepth(const std::string& queue, long int depth) { fQueueDepth[queue] = depth; }
+
+	// only writes the file if at least interval seconds have passed since the last update
+	void Update(long int entries, long int events);
+	// marks all entries of the current job as processed
+	void Finish(long int events);
+
+private:
+	bool Write(bool finished);
+
+	std::string fFileName;
+	bool fJson;
+	std::chrono::seconds fInterval;
+	std::chrono::steady_clock::time_point fStart;
+	std::chrono::steady_clock::time_point fLastUpdate;
+
+	int fJob;
+	int fJobs;
+	long int fTotalEntries;
+	long int fEntries;
+	long int fEvents;
+	std::string fInputFile;
+	std::map<std::string, long int> fQueueDepth;
+};
+#endif
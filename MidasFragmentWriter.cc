@@ -0,0 +1,155 @@
+#include "MidasFragmentWriter.hh"
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <ctime>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+	// alignment needed for O_DIRECT
+	const size_t kAlignment = 4096;
+
+	const uint16_t kBeginOfRun = 0x8000;
+	const uint16_t kEndOfRun = 0x8001;
+	const uint16_t kMidasMagic = 0x494d;
+	// bank format version 1, 32 bit banks, 64 bit aligned
+	const uint32_t kBankFlags = 0x31;
+	const uint32_t kTypeUInt8 = 1;
+}
+
+MidasFragmentWriter::MidasFragmentWriter(const std::string& fileName, int runNumber, size_t bufferSize, bool directIO)
+	: fFileName(fileName), fFd(-1), fRunNumber(runNumber), fDirectIO(directIO), fGood(true), fBuffer(nullptr), fPosition(0), fSerialNumber(0)
+{
+	//the buffer has to be a multiple of the alignment and large enough for big events
+	fBufferSize = ((bufferSize + kAlignment - 1)/kAlignment)*kAlignment;
+	if(fBufferSize < kAlignment) {
+		fBufferSize = kAlignment;
+	}
+	if(posix_memalign(reinterpret_cast<void**>(&fBuffer), kAlignment, fBufferSize) != 0) {
+		std::cerr<<"Failed to allocate "<<fBufferSize<<" bytes for binary fragment output!"<<std::endl;
+		fBuffer = nullptr;
+		return;
+	}
+
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+	if(fDirectIO) {
+		flags |= O_DIRECT;
+	}
+#else
+	fDirectIO = false;
+#endif
+	fFd = open(fFileName.c_str(), flags, 0644);
+	if(fFd < 0 && fDirectIO) {
+		//not all file systems support O_DIRECT
+		fDirectIO = false;
+		fFd = open(fFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+	if(fFd < 0) {
+		std::cerr<<"Failed to open file '"<<fFileName<<"': "<<strerror(errno)<<std::endl;
+		return;
+	}
+
+	//begin-of-run event without ODB dump
+	WriteHeader(kBeginOfRun, kMidasMagic, fRunNumber, 0);
+}
+
+MidasFragmentWriter::~MidasFragmentWriter() {
+	Close();
+	free(fBuffer);
+}
+
+void MidasFragmentWriter::WriteHeader(uint16_t eventId, uint16_t triggerMask, uint32_t serialNumber, uint32_t dataSize) {
+	uint32_t timeStamp = static_cast<uint32_t>(time(nullptr));
+	Append(&eventId, sizeof(eventId));
+	Append(&triggerMask, sizeof(triggerMask));
+	Append(&serialNumber, sizeof(serialNumber));
+	Append(&timeStamp, sizeof(timeStamp));
+	Append(&dataSize, sizeof(dataSize));
+}
+
+void MidasFragmentWriter::WriteEvent(const std::vector<FragmentRecord>& fragments) {
+	if(!IsOpen()) {
+		return;
+	}
+	uint32_t bankSize = fragments.size()*kRecordSize;
+	//bank header (size and flags) and 32 bit bank (name, type, size, and reserved word for 64 bit alignment)
+	uint32_t bankHeaderSize = bankSize + 16;
+	WriteHeader(1, 0, fSerialNumber++, bankHeaderSize + 8);
+	Append(&bankHeaderSize, sizeof(bankHeaderSize));
+	Append(&kBankFlags, sizeof(kBankFlags));
+	Append("FRAG", 4);
+	Append(&kTypeUInt8, sizeof(kTypeUInt8));
+	Append(&bankSize, sizeof(bankSize));
+	uint32_t reserved = 0;
+	Append(&reserved, sizeof(reserved));
+
+	char record[kRecordSize];
+	for(const auto& fragment : fragments) {
+		memset(record, 0, kRecordSize);
+		memcpy(record, &fragment.fTimeStamp, 8);
+		memcpy(record + 8, &fragment.fDaqTimeStamp, 8);
+		memcpy(record + 16, &fragment.fAddress, 4);
+		memcpy(record + 20, &fragment.fCfd, 4);
+		memcpy(record + 24, &fragment.fCharge, 4);
+		memcpy(record + 28, &fragment.fKValue, 2);
+		Append(record, kRecordSize);
+	}
+}
+
+void MidasFragmentWriter::Append(const void* data, size_t size) {
+	const char* pos = static_cast<const char*>(data);
+	while(size > 0) {
+		size_t n = fBufferSize - fPosition;
+		if(n > size) n = size;
+		memcpy(fBuffer + fPosition, pos, n);
+		fPosition += n;
+		pos += n;
+		size -= n;
+		if(fPosition == fBufferSize) {
+			Flush(false);
+		}
+	}
+}
+
+bool MidasFragmentWriter::Flush(bool final) {
+	if(fPosition == 0) {
+		return fGood;
+	}
+#ifdef O_DIRECT
+	//O_DIRECT only allows aligned sizes, so the last (partial) buffer is written through the page cache
+	if(final && fDirectIO && fPosition%kAlignment != 0) {
+		fcntl(fFd, F_SETFL, fcntl(fFd, F_GETFL) & ~O_DIRECT);
+	}
+#endif
+	size_t written = 0;
+	while(written < fPosition) {
+		ssize_t n = write(fFd, fBuffer + written, fPosition - written);
+		if(n < 0) {
+			if(errno == EINTR) continue;
+			std::cerr<<"Failed to write to '"<<fFileName<<"': "<<strerror(errno)<<std::endl;
+			fGood = false;
+			break;
+		}
+		written += n;
+	}
+	fPosition = 0;
+	return fGood;
+}
+
+bool MidasFragmentWriter::Close() {
+	if(!IsOpen()) {
+		return fGood;
+	}
+	WriteHeader(kEndOfRun, kMidasMagic, fRunNumber, 0);
+	Flush(true);
+	if(close(fFd) != 0) {
+		fGood = false;
+	}
+	fFd = -1;
+	return fGood;
+}
@@ -0,0 +1,41 @@
+#ifndef __MIDASFRAGMENTWRITER_HH
+#define __MIDASFRAGMENTWRITER_HH
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "FragmentRecord.hh"
+
+// writes fragments as a stream of MIDAS-like events, one event per simulated event with a single 32 bit bank "FRAG"
+// each fragment in the bank is a fixed-size record of 32 bytes:
+// timestamp (int64), daq timestamp (int64), address (uint32), cfd (int32), charge (float), k-value (int16), padding (2 bytes)
+// the output is collected in a large aligned buffer which is written at once (optionally bypassing the page cache with O_DIRECT)
+class MidasFragmentWriter {
+public:
+	MidasFragmentWriter(const std::string& fileName, int runNumber, size_t bufferSize, bool directIO);
+	~MidasFragmentWriter();
+
+	bool IsOpen() { return fFd >= 0; }
+	void WriteEvent(const std::vector<FragmentRecord>& fragments);
+	bool Close();
+
+	static const size_t kRecordSize = 32;
+
+private:
+	void WriteHeader(uint16_t eventId, uint16_t triggerMask, uint32_t serialNumber, uint32_t dataSize);
+	void Append(const void* data, size_t size);
+	bool Flush(bool final);
+
+	std::string fFileName;
+	int fFd;
+	int fRunNumber;
+	bool fDirectIO;
+	bool fGood;
+	char* fBuffer;
+	size_t fBufferSize;
+	size_t fPosition;
+	uint32_t fSerialNumber;
+};
+#endif
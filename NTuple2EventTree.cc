@@ -2,6 +2,14 @@
 #include <iomanip>
 #include <vector>
 #include <string>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <set>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/stat.h>
 
 #include "TFile.h"
 #include "TH1F.h"
@@ -12,12 +20,67 @@
 
 #include "Settings.hh"
 #include "Converter.hh"
+#include "IncrementalState.hh"
+
+//output directory of each settings file: with a single settings file the output goes into the current directory,
+//otherwise each settings file gets a directory named after it (without extension), so all of them keep the name analysisRRRRR_SSS.root
+//returns an empty vector if the directories can't be used
+std::vector<std::string> OutputDirectories(const std::vector<std::string>& settingsFileNames, const std::string& baseDirectory = "") {
+    std::vector<std::string> directories;
+    if(settingsFileNames.size() < 2) {
+        directories.push_back(baseDirectory);
+        return directories;
+    }
+    std::set<std::string> names;
+    for(const auto& settingsFileName : settingsFileNames) {
+        std::string name = settingsFileName.substr(settingsFileName.find_last_of('/') + 1);
+        name = name.substr(0, name.find_last_of('.'));
+        if(name.empty() || !names.insert(name).second) {
+            std::cerr<<"Settings files need different names (without directory and extension) to write their output to separate directories, \""<<settingsFileName<<"\" doesn't!"<<std::endl;
+            return std::vector<std::string>();
+        }
+        std::string directory = baseDirectory.empty() ? name : baseDirectory + "/" + name;
+        if(mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            std::cerr<<"Failed to create directory '"<<directory<<"': "<<strerror(errno)<<std::endl;
+            return std::vector<std::string>();
+        }
+        directories.push_back(directory);
+    }
+    return directories;
+}
+
+//converts one job of a manifest, the settings and output directories are shared by all jobs
+bool ConvertJob(std::vector<std::string>& inputFileNames, std::vector<Settings*>& settings, const std::vector<std::string>& outputDirectories, int runNumber, int subRunNumber, TRunInfo* runInfo, bool writeFragmentTree, bool writeBinaryFragments, Metrics* metrics) {
+    //the converter gives up on jobs without any existing input file, so we check here to continue with the next job
+    bool anyFile = false;
+    for(const auto& inputFileName : inputFileNames) {
+        if(FileExists(inputFileName)) {
+            anyFile = true;
+            break;
+        }
+    }
+    if(!anyFile) {
+        std::cerr<<"None of the input files of run "<<runNumber<<", sub-run "<<subRunNumber<<" exist!"<<std::endl;
+        return false;
+    }
+
+    //channels are created while converting and written to the output, so each job starts without any
+    TChannel::DeleteAllChannels();
+
+    Converter converter(inputFileNames, settings[0]);
+    for(size_t i = 0; i < settings.size(); ++i) {
+        converter.AddConfiguration(new Configuration(settings[i], runNumber, subRunNumber, runInfo, writeFragmentTree, i+1, writeBinaryFragments, outputDirectories[i]));
+    }
+    converter.SetMetrics(metrics);
+
+    return converter.Run();
+}
 
 int main(int argc, char** argv) {
     //parse all command line options
     CommandLineInterface interface;
-    std::string settingsFileName;
-    interface.Add("-sf","settings file (required)", &settingsFileName);
+    std::vector<std::string> settingsFileNames;
+    interface.Add("-sf","settings file(s) (required, one output file per settings file)", &settingsFileNames);
     std::vector<std::string> inputFileNames;
     interface.Add("-if","input file(s) (required)", &inputFileNames);
     int runNumber = 0;
@@ -30,17 +93,39 @@ int main(int argc, char** argv) {
     interface.Add("-vl","verbosity level (default = 0)", &verbosityLevel);
 	 bool writeFragmentTree = false;
 	 interface.Add("-wf","write FragmentTree to separate file", &writeFragmentTree);
+	 bool writeBinaryFragments = false;
+	 interface.Add("-wb","write fragments to binary MIDAS-like file", &writeBinaryFragments);
+	 std::string cacheFileName;
+	 interface.Add("-cache","read hits from this hit cache file if it exists (default = '')", &cacheFileName);
+	 std::string metricsFileName;
+	 interface.Add("-mf","metrics file, updated periodically with progress and throughput (JSON if name ends in .json, Prometheus text format otherwise, default = '')", &metricsFileName);
+	 int metricsInterval = 10;
+	 interface.Add("-mi","interval in seconds between updates of the metrics file (default = 10)", &metricsInterval);
+	 std::string buildCacheFileName;
+	 interface.Add("-build-cache","write hits of input file(s) to this hit cache file and exit (default = '')", &buildCacheFileName);
+	 int estimateEvents = 0;
+	 interface.Add("-estimate","convert this many events spread across the input in memory, and estimate time and output size of the full conversion (default = 0)", &estimateEvents);
+	 std::string manifestFileName;
+	 interface.Add("-manifest","file with one job per line: run number, sub-run number, run info file ('-' for none), and input file(s) (default = '')", &manifestFileName);
+	 std::string incrementalDirectory;
+	 interface.Add("-incremental","convert only new or changed input files, keeping the output of each file in this directory, and merge all of them (default = '')", &incrementalDirectory);
 
     //-------------------- check flags and arguments --------------------
     interface.CheckFlags(argc, argv);
 
-    if(inputFileNames.size() == 0) {
+    if(inputFileNames.size() == 0 && cacheFileName.empty() && manifestFileName.empty()) {
         std::cerr<<"Missing input file name(s)!"<<std::endl;
         return 1;
     }
 
     //read settings
-    Settings settings(settingsFileName, verbosityLevel);
+    if(settingsFileNames.empty()) {
+        settingsFileNames.push_back("");
+    }
+    std::vector<Settings*> settings;
+    for(auto settingsFileName : settingsFileNames) {
+        settings.push_back(new Settings(settingsFileName, verbosityLevel));
+    }
 
 	 //read run info
 	 TRunInfo* runInfo = new TRunInfo;
@@ -48,8 +133,169 @@ int main(int argc, char** argv) {
 		 runInfo->ReadInfoFile(runInfoFile.c_str());
 	 }
 
-    //create converter and run
-    Converter converter(inputFileNames, runNumber, subRunNumber, runInfo, &settings, writeFragmentTree);
+    Metrics* metrics = nullptr;
+    if(!metricsFileName.empty()) {
+        metrics = new Metrics(metricsFileName, metricsInterval);
+    }
+
+    //batch mode: all jobs of the manifest are converted one after the other, re-using the settings
+    if(!manifestFileName.empty()) {
+        if(!cacheFileName.empty() || !buildCacheFileName.empty() || estimateEvents > 0 || !incrementalDirectory.empty()) {
+            std::cerr<<"Hit cache, estimate, and incremental conversion can't be used with a manifest!"<<std::endl;
+            return 1;
+        }
+        std::ifstream manifest(manifestFileName.c_str());
+        if(!manifest.is_open()) {
+            std::cerr<<"Failed to open manifest '"<<manifestFileName<<"'!"<<std::endl;
+            return 1;
+        }
+        std::vector<std::string> outputDirectories = OutputDirectories(settingsFileNames);
+        if(outputDirectories.empty()) {
+            return 1;
+        }
+        //read all jobs first, so the metrics know the number of jobs
+        std::vector<std::string> jobs;
+        std::string line;
+        while(std::getline(manifest, line)) {
+            if(line.empty() || line[0] == '#') continue;
+            jobs.push_back(line);
+        }
+        int nJobs = jobs.size();
+        int nFailed = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(int job = 0; job < nJobs; ++job) {
+            line = jobs[job];
+            if(metrics != nullptr) {
+                metrics->StartJob(job+1, nJobs);
+            }
+            std::istringstream str(line);
+            int jobRunNumber;
+            int jobSubRunNumber;
+            std::string jobRunInfoFile;
+            if(!(str>>jobRunNumber>>jobSubRunNumber>>jobRunInfoFile)) {
+                std::cerr<<"Failed to parse line '"<<line<<"' of manifest, skipping it!"<<std::endl;
+                ++nFailed;
+                continue;
+            }
+            std::vector<std::string> jobInputFileNames;
+            std::string fileName;
+            while(str>>fileName) {
+                jobInputFileNames.push_back(fileName);
+            }
+            std::cout<<"job #"<<job+1<<": run "<<jobRunNumber<<", sub-run "<<jobSubRunNumber<<" from "<<jobInputFileNames.size()<<" file(s)"<<std::endl;
+
+            TRunInfo* jobRunInfo = new TRunInfo;
+            if(jobRunInfoFile != "-") {
+                jobRunInfo->ReadInfoFile(jobRunInfoFile.c_str());
+            }
+            if(!ConvertJob(jobInputFileNames, settings, outputDirectories, jobRunNumber, jobSubRunNumber, jobRunInfo, writeFragmentTree, writeBinaryFragments, metrics)) {
+                std::cerr<<"processing of run "<<jobRunNumber<<", sub-run "<<jobSubRunNumber<<" ended abnormally!"<<std::endl;
+                ++nFailed;
+            }
+            delete jobRunInfo;
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout<<"converted "<<nJobs-nFailed<<" of "<<nJobs<<" jobs in "<<elapsed<<" s"<<(nJobs > 0 ? Form(" (%.3f s per job)", elapsed/nJobs) : "")<<std::endl;
+        return nFailed > 0 ? 1 : 0;
+    }
+
+    //incremental conversion: each new or changed input file is converted on its own, with a seed that only depends on the file
+    if(!incrementalDirectory.empty()) {
+        if(!cacheFileName.empty() || !buildCacheFileName.empty() || estimateEvents > 0) {
+            std::cerr<<"Hit cache and estimate can't be used for incremental conversion!"<<std::endl;
+            return 1;
+        }
+        IncrementalState state(incrementalDirectory, verbosityLevel);
+        std::vector<std::string> changedFileNames;
+        for(const auto& inputFileName : inputFileNames) {
+            if(state.UpToDate(inputFileName)) {
+                if(verbosityLevel > 0) {
+                    std::cout<<inputFileName<<" has already been converted"<<std::endl;
+                }
+                continue;
+            }
+            changedFileNames.push_back(inputFileName);
+        }
+        for(size_t job = 0; job < changedFileNames.size(); ++job) {
+            const std::string& inputFileName = changedFileNames[job];
+            if(metrics != nullptr) {
+                metrics->StartJob(job+1, changedFileNames.size());
+            }
+            std::string partDirectory = state.PartDirectory(inputFileName);
+            if(partDirectory.empty()) {
+                return 1;
+            }
+            std::cout<<"converting "<<inputFileName<<" into "<<partDirectory<<std::endl;
+            std::vector<std::string> partInput(1, inputFileName);
+            {
+                std::vector<std::string> partDirectories = OutputDirectories(settingsFileNames, partDirectory);
+                if(partDirectories.empty()) {
+                    return 1;
+                }
+                Converter converter(partInput, settings[0]);
+                for(size_t i = 0; i < settings.size(); ++i) {
+                    converter.AddConfiguration(new Configuration(settings[i], runNumber, subRunNumber, runInfo, writeFragmentTree, IncrementalState::Seed(inputFileName, i), writeBinaryFragments, partDirectories[i]));
+                }
+                converter.SetMetrics(metrics);
+                if(!converter.Run()) {
+                    std::cerr<<"processing of "<<inputFileName<<" ended abnormally!"<<std::endl;
+                    return 1;
+                }
+            }
+            state.Done(inputFileName);
+        }
+        //the merged files go into the same directories as without incremental conversion
+        if(OutputDirectories(settingsFileNames).empty()) {
+            return 1;
+        }
+        if(!state.Merge(inputFileNames)) {
+            return 1;
+        }
+        return 0;
+    }
+
+    //create converter
+    Converter converter(inputFileNames, settings[0], cacheFileName);
+
+    if(!buildCacheFileName.empty()) {
+        if(!converter.WriteCache(buildCacheFileName)) {
+            std::cerr<<"failed to create hit cache!"<<std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    //create one configuration for each settings file, each with its own random number stream and output file(s)
+    std::vector<std::string> outputDirectories = OutputDirectories(settingsFileNames);
+    if(outputDirectories.empty()) {
+        return 1;
+    }
+    for(size_t i = 0; i < settings.size(); ++i) {
+        if(settings[i]->NtupleName() != settings[0]->NtupleName()) {
+            std::cerr<<"Warning, settings file #"<<i<<" uses ntuple name \""<<settings[i]->NtupleName()<<"\", but all inputs are read with \""<<settings[0]->NtupleName()<<"\" from the first settings file!"<<std::endl;
+        }
+        for(int system = 0; system < static_cast<int>(EDetectorSystem::kNumberOfSystems); ++system) {
+            if(settings[i]->SystemActive(static_cast<EDetectorSystem>(system)) && !settings[0]->SystemActive(static_cast<EDetectorSystem>(system))) {
+                std::cerr<<"Warning, settings file #"<<i<<" activates system #"<<system<<", but its hits are dropped when reading because it isn't active in the first settings file!"<<std::endl;
+            }
+        }
+        if(settings.size() > 1) {
+            std::cout<<"settings file #"<<i<<" will be written to "<<outputDirectories[i]<<"/"<<Form("analysis%05d_%03d.root", runNumber, subRunNumber)<<std::endl;
+        }
+        //in estimate mode nothing is written to disk, the output files are kept in memory
+        converter.AddConfiguration(new Configuration(settings[i], runNumber, subRunNumber, runInfo, writeFragmentTree, i+1, writeBinaryFragments && estimateEvents <= 0, outputDirectories[i], estimateEvents > 0));
+    }
+
+    if(estimateEvents > 0) {
+        if(!converter.Estimate(estimateEvents)) {
+            return 1;
+        }
+        return 0;
+    }
+
+    converter.SetMetrics(metrics);
+
+    //run converter
     if(!converter.Run()) {
         std::cerr<<"processing ended abnormally!"<<std::endl;
         return 1;
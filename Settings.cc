@@ -1,5 +1,8 @@
 #include "Settings.hh"
 
+#include <algorithm>
+#include <sstream>
+
 #include "TEnv.h"
 #include "TString.h"
 
@@ -16,14 +19,87 @@ Settings::Settings(std::string fileName, int verbosityLevel)
 
     fBufferSize = env.GetValue("BufferSize",1024000);
 
+    // reading of input files: size of the TTreeCache (0 = ROOT default), threads used to decompress baskets (0 = none),
+    // and how much of the next input file is read ahead in the background (0 = no read-ahead)
+    fTreeCacheSizeMB = env.GetValue("TreeCacheSizeMB",0);
+
+    fUnzipThreads = env.GetValue("UnzipThreads",0);
+
+    fPrefetchSizeMB = env.GetValue("PrefetchSizeMB",0);
+
+    // number of entries of each input file are cached in this file (empty = no cache), and counted with this many threads if needed
+    fEntryCountFile = env.GetValue("EntryCountFile","");
+
+    fScanThreads = env.GetValue("ScanThreads",8);
+
     fSortNumberOfEvents = env.GetValue("SortNumberOfEvents",0);
 
+    // Sorted: hits of an event are contiguous (default), Unsorted: group hits by event number, Auto: check input and group hits if necessary
+    fEventOrder = env.GetValue("EventOrder","Sorted");
+
+    fSortBufferSize = env.GetValue("SortBufferSize",4000000);
+
+    fSortDirectory = env.GetValue("SortDirectory","/tmp");
+
     fWriteTree = env.GetValue("WriteTree",true);
 
+    // start a new sub-run file after this many events or this size of the analysis file (0 = never)
+    fRolloverEvents = env.GetValue("RolloverEvents",0);
+
+    fRolloverSizeMB = env.GetValue("RolloverSizeMB",0.);
+
+    // binary fragment output (-wb), written in blocks of this size, optionally bypassing the page cache
+    fBinaryBufferSizeMB = env.GetValue("BinaryBufferSizeMB",16);
+
+    fBinaryDirectIO = env.GetValue("BinaryDirectIO",false);
+
 	 fKValue = env.GetValue("KValue", 700);
 
 	 fDontSmearEnergy = env.GetValue("DontSmearEnergy", false);
 
+    // active detector systems (separated by spaces or commas), hits of all other systems are dropped right after reading them
+    std::vector<std::string> systemNames = {"Griffin", "GriffinBgo", "LaBr", "Sceptar", "Descant", "Paces"};
+    std::string systems = env.GetValue("Systems", "");
+    std::replace(systems.begin(), systems.end(), ',', ' ');
+    std::istringstream systemsStream(systems);
+    std::string systemName;
+    fAllSystemsActive = true;
+    fSystemActive.assign(systemNames.size(), true);
+    while(systemsStream>>systemName) {
+        if(fAllSystemsActive) {
+            fAllSystemsActive = false;
+            fSystemActive.assign(systemNames.size(), false);
+        }
+        auto it = std::find(systemNames.begin(), systemNames.end(), systemName);
+        if(it == systemNames.end()) {
+            std::cerr<<"Unknown system \""<<systemName<<"\" in \"Systems\", known systems are Griffin, GriffinBgo, LaBr, Sceptar, Descant, and Paces!"<<std::endl;
+            throw;
+        }
+        fSystemActive[it - systemNames.begin()] = true;
+    }
+
+    // trigger emulation, events that don't fulfill the trigger condition aren't written to the tree
+    fSuppressEmptyEvents = env.GetValue("SuppressEmptyEvents", false);
+    fTriggerMultiplicity.resize(systemNames.size());
+    fTriggerEnabled = fSuppressEmptyEvents;
+    for(size_t system = 0; system < systemNames.size(); ++system) {
+        fTriggerMultiplicity[system] = env.GetValue(Form("Trigger.%s.Multiplicity", systemNames[system].c_str()), 0);
+        if(fTriggerMultiplicity[system] > 0) {
+            fTriggerEnabled = true;
+            if(!fSystemActive[system]) {
+                std::cerr<<"Warning, trigger requires "<<systemNames[system]<<", but it isn't one of the active systems, no event will fulfill this condition!"<<std::endl;
+            }
+        }
+    }
+    fTriggerRequireAll = (std::string(env.GetValue("Trigger.Mode", "Or")) == "And");
+
+    // event sampling, unselected events are skipped before their hits are read
+    fSamplePrescale = env.GetValue("Sample.Prescale", 1);
+
+    fSampleFraction = env.GetValue("Sample.Fraction", 1.);
+
+    fSampleSeed = env.GetValue("Sample.Seed", 1);
+
     fWriteGriffinAddbackVector = env.GetValue("WriteGriffinAddbackVector", false);
 
     fGriffinAddbackVectorLengthmm = env.GetValue("GriffinAddbackVectorLengthmm", 105.0);
@@ -348,3 +424,31 @@ Settings::Settings(std::string fileName, int verbosityLevel)
         fTimeWindow[9000][detector][0] = env.GetValue(Form("Paces.%d.TimeWindow.sec",detector),0.0);
     }
 }
+
+int Settings::DetectorSystem(int systemID) {
+    switch(systemID) {
+        case 1000:
+            return static_cast<int>(EDetectorSystem::kGriffin);
+        case 1010:
+        case 1020:
+        case 1030:
+        case 1040:
+        case 1050:
+        case 3000:
+            return static_cast<int>(EDetectorSystem::kGriffinBgo);
+        case 2000:
+            return static_cast<int>(EDetectorSystem::kLaBr);
+        case 5000:
+            return static_cast<int>(EDetectorSystem::kSceptar);
+        case 50:
+            return static_cast<int>(EDetectorSystem::kPaces);
+        case 8010:
+        case 8020:
+        case 8030:
+        case 8040:
+        case 8050:
+            return static_cast<int>(EDetectorSystem::kDescant);
+        default:
+            return -1;
+    }
+}
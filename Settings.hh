@@ -7,6 +7,9 @@
 
 #include "TF1.h"
 
+// detector systems written to the analysis tree (one branch each)
+enum class EDetectorSystem { kGriffin, kGriffinBgo, kLaBr, kSceptar, kDescant, kPaces, kNumberOfSystems };
+
 class Settings {
 public:
     Settings(std::string, int);
@@ -18,12 +21,70 @@ public:
 
     int BufferSize() { return fBufferSize; }
 
+    int TreeCacheSizeMB() { return fTreeCacheSizeMB; }
+
+    int UnzipThreads() { return fUnzipThreads; }
+
+    int PrefetchSizeMB() { return fPrefetchSizeMB; }
+
+    std::string EntryCountFile() { return fEntryCountFile; }
+
+    int ScanThreads() { return fScanThreads; }
+
     int SortNumberOfEvents() { return fSortNumberOfEvents; }
 
+    std::string EventOrder() { return fEventOrder; }
+
+    int SortBufferSize() { return fSortBufferSize; }
+
+    std::string SortDirectory() { return fSortDirectory; }
+
     bool WriteTree() { return fWriteTree; }
 
+    int RolloverEvents() { return fRolloverEvents; }
+
+    double RolloverSizeMB() { return fRolloverSizeMB; }
+
+    int BinaryBufferSizeMB() { return fBinaryBufferSizeMB; }
+
+    bool BinaryDirectIO() { return fBinaryDirectIO; }
+
 	 int KValue() { return fKValue; }
 
+    bool SuppressEmptyEvents() { return fSuppressEmptyEvents; }
+
+    // minimum number of fragments (channels) of this system required by the trigger, 0 means the system isn't part of the trigger
+    int TriggerMultiplicity(EDetectorSystem system) { return fTriggerMultiplicity[static_cast<int>(system)]; }
+
+    // if true all systems with a multiplicity condition have to fulfill it, otherwise one is enough
+    bool TriggerRequireAll() { return fTriggerRequireAll; }
+
+    bool TriggerEnabled() { return fTriggerEnabled; }
+
+    // systems set with "Systems", all systems are active by default
+    bool SystemActive(EDetectorSystem system) { return fSystemActive[static_cast<int>(system)]; }
+
+    bool AllSystemsActive() { return fAllSystemsActive; }
+
+    // whether hits with this system ID from the simulation are converted, hits of systems without a branch are only kept if all systems are active
+    bool HitActive(int systemID) {
+        if(fAllSystemsActive) return true;
+        int system = DetectorSystem(systemID);
+        return system >= 0 && fSystemActive[system];
+    }
+
+    // detector system of a system ID from the simulation, -1 if there is no branch for it
+    static int DetectorSystem(int systemID);
+
+    // only convert every k-th event and/or a random fraction of events (selected by event number)
+    int SamplePrescale() { return fSamplePrescale; }
+
+    double SampleFraction() { return fSampleFraction; }
+
+    ULong64_t SampleSeed() { return fSampleSeed; }
+
+    bool SamplingEnabled() { return fSamplePrescale > 1 || fSampleFraction < 1.; }
+
     bool WriteGriffinAddbackVector() { return fWriteGriffinAddbackVector; }
 
 	 bool DontSmearEnergy() { return fDontSmearEnergy; }
@@ -70,10 +131,32 @@ private:
 
     int fVerbosityLevel;
     int fBufferSize;
+    int fTreeCacheSizeMB;
+    int fUnzipThreads;
+    int fPrefetchSizeMB;
+    std::string fEntryCountFile;
+    int fScanThreads;
     int fSortNumberOfEvents;
 
+    std::string fEventOrder;
+    int fSortBufferSize;
+    std::string fSortDirectory;
+
     bool fWriteTree;
+    int fRolloverEvents;
+    double fRolloverSizeMB;
+    int fBinaryBufferSizeMB;
+    bool fBinaryDirectIO;
 	 int fKValue;
+    bool fSuppressEmptyEvents;
+    std::vector<int> fTriggerMultiplicity;
+    bool fTriggerRequireAll;
+    bool fTriggerEnabled;
+    std::vector<bool> fSystemActive;
+    bool fAllSystemsActive;
+    int fSamplePrescale;
+    double fSampleFraction;
+    ULong64_t fSampleSeed;
     bool fWriteGriffinAddbackVector;
 	 bool fDontSmearEnergy;
 